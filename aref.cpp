@@ -26,21 +26,38 @@
 #include "exceptions.h"
 #include <sstream>
 #include "gdsio.h"
+#include "stringtable.h"
 #include "structures.h"
 #include "library.h"
 
 namespace GDS
 {
 
-	ARef::ARef(Structure* parent) :Element(AREF, parent)
+	ARef::ARef(Structure* parent) :Element(AREF, parent), X(storage()), Y(storage())
 	{
 		Eflags = 0;
-		SName = "";
+		SName = 0;
+		Target = nullptr;
 		Strans = 0;
 		Row = 0;
 		Col = 0;
 		Angle = 0;
 		Mag = 1;
+		Pitch[0] = Pitch[1] = Pitch[2] = Pitch[3] = 0;
+	}
+
+	void ARef::place()
+	{
+		double x = X.empty() ? 0 : X[0];
+		double y = Y.empty() ? 0 : Y[0];
+		Placement = Transform(x, y, Angle, Mag, (Strans & REFLECTION) != 0);
+		Pitch[0] = Pitch[1] = Pitch[2] = Pitch[3] = 0;
+		if (X.size() < 3 || Col <= 0 || Row <= 0)
+			return;
+		Pitch[0] = (double)((long long)X[1] - X[0]) / Col;
+		Pitch[1] = (double)((long long)Y[1] - Y[0]) / Col;
+		Pitch[2] = (double)((long long)X[2] - X[0]) / Row;
+		Pitch[3] = (double)((long long)Y[2] - Y[0]) / Row;
 	}
 
 	ARef::~ARef()
@@ -49,7 +66,7 @@ namespace GDS
 
 	std::string ARef::structName() const
 	{
-		return SName;
+		return internedString(SName);
 	}
 
 	short ARef::row() const
@@ -64,8 +81,8 @@ namespace GDS
 
 	void ARef::xy(std::vector<int> &x, std::vector<int> &y) const
 	{
-		x = X;
-		y = Y;
+		x.assign(X.begin(), X.end());
+		y.assign(Y.begin(), Y.end());
 	}
 
 	double ARef::angle() const
@@ -88,58 +105,109 @@ namespace GDS
 		return Strans & flag;
 	}
 
+	Transform ARef::transform(int col, int row) const
+	{
+		Transform result = Placement;
+		if (col != 0 || row != 0)
+			result.translate(col * Pitch[0] + row * Pitch[2], col * Pitch[1] + row * Pitch[3]);
+		return result;
+	}
+
+	void ARef::pitch(double &col_x, double &col_y, double &row_x, double &row_y) const
+	{
+		col_x = Pitch[0];
+		col_y = Pitch[1];
+		row_x = Pitch[2];
+		row_y = Pitch[3];
+	}
+
+	StringId ARef::structNameId() const
+	{
+		return SName;
+	}
+
 	void ARef::setStructName(std::string name)
 	{
-		SName = name;
+		SName = internString(name);
+		Target = nullptr;
+		if (parent() != nullptr && parent()->library() != nullptr)
+			parent()->library()->link(this);
+		touch();
+	}
+
+	Structure* ARef::target() const
+	{
+		return Target != nullptr ? *Target : nullptr;
+	}
+
+	void ARef::setTarget(Structure* const* slot)
+	{
+		Target = slot;
 	}
 
 	void ARef::setRowCol(int row, int col)
 	{
 		Row = row;
 		Col = col;
+		place();
+		touch();
 	}
 
 	void ARef::setXY(std::vector<int> &x, std::vector<int> &y)
 	{
-		X = x;
-		Y = y;
+		X.assign(x.begin(), x.end());
+		Y.assign(y.begin(), y.end());
+		place();
+		touch();
 	}
 
 	void ARef::setAngle(double angle)
 	{
 		Angle = angle;
+		place();
+		touch();
 	}
 
 	void ARef::setMag(double mag)
 	{
 		Mag = mag;
+		place();
+		touch();
 	}
 
 	void ARef::setStrans(short strans)
 	{
 		Strans = strans;
+		place();
+		touch();
 	}
 
 	void ARef::setStrans(STRANS_FLAG flag, bool enable)
 	{
 		Strans = enable ? (Strans | flag) : (Strans & (~flag));
+		place();
+		touch();
 	}
 
-	bool ARef::read(std::ifstream &in)
+	bool ARef::read(RecordReader &reader)
 	{
 #ifdef _DEBUG_LOG
 		LogIO* log = LogIO::getInstance();
 #endif
+		const Record &rec = reader.record();
 		bool finished = false;
 		while (!finished)
 		{
-			short record_size = readShort(in);
-			Byte record_type = readByte(in);
-			Byte data_type = readByte(in);
+			if (!reader.next())
+				throw FormatError("unexpected end of file in AREF.");
+			int record_size = rec.size;
+			Byte record_type = rec.record_type;
+			Byte data_type = rec.data_type;
 			switch (record_type)
 			{
 			case ENDEL:
 				finished = true;
+				place();
 #ifdef _DEBUG_LOG
 				{
 					std::stringstream ss;
@@ -158,7 +226,7 @@ namespace GDS
 					std::string msg = ss.str();
 					throw FormatError(msg);
 				}
-				Eflags = readShort(in);
+				Eflags = rec.getShort();
 #ifdef _DEBUG_LOG
 				{
 					std::stringstream ss;
@@ -177,11 +245,11 @@ namespace GDS
 					std::string msg = ss.str();
 					throw FormatError(msg);
 				}
-				SName = readString(in, record_size - 4);
+				SName = internString(rec.getString());
 #ifdef _DEBUG_LOG
 				{
 					std::stringstream ss;
-					ss << std::dec << " " << record_size << " " << Record_name[record_type] << " " << data_type << " " << SName << std::endl;
+					ss << std::dec << " " << record_size << " " << Record_name[record_type] << " " << data_type << " " << internedString(SName) << std::endl;
 					log->write(ss.str());
 				}
 #endif
@@ -196,12 +264,11 @@ namespace GDS
 					std::string msg = ss.str();
 					throw FormatError(msg);
 				}
-				for (int i = 0; i < 3; i++)
 				{
-					int x = readInteger(in);
-					int y = readInteger(in);
-					X.push_back(x);
-					Y.push_back(y);
+					size_t begin = X.size();
+					X.resize(begin + 3);
+					Y.resize(begin + 3);
+					decodeXY(rec.data, 3, &X[begin], &Y[begin]);
 				}
 #ifdef _DEBUG_LOG
 				{
@@ -226,7 +293,7 @@ namespace GDS
 					std::string msg = ss.str();
 					throw FormatError(msg);
 				}
-				Strans = readShort(in);
+				Strans = rec.getShort();
 #ifdef _DEBUG_LOG
 				{
 					std::stringstream ss;
@@ -245,8 +312,8 @@ namespace GDS
 					std::string msg = ss.str();
 					throw FormatError(msg);
 				}
-				Col = readShort(in);
-				Row = readShort(in);
+				Col = rec.getShort(0);
+				Row = rec.getShort(1);
 #ifdef _DEBUG_LOG
 				{
 					std::stringstream ss;
@@ -265,7 +332,7 @@ namespace GDS
 					std::string msg = ss.str();
 					throw FormatError(msg);
 				}
-				Mag = readDouble(in);
+				Mag = rec.getDouble();
 #ifdef _DEBUG_LOG
 				{
 					std::stringstream ss;
@@ -284,7 +351,7 @@ namespace GDS
 					std::string msg = ss.str();
 					throw FormatError(msg);
 				}
-				Angle = readDouble(in);
+				Angle = rec.getDouble();
 #ifdef _DEBUG_LOG
 				{
 					std::stringstream ss;
@@ -300,69 +367,18 @@ namespace GDS
 		return true;
 	}
 
-	bool ARef::write(std::ofstream &out)
+	bool ARef::write(RecordWriter &writer)
 	{
-		short record_size;
-
-		// AREF
-		record_size = 4;
-		writeShort(out, record_size);
-		writeByte(out, AREF);
-		writeByte(out, NoData);
-
-		record_size = 6;
-		writeShort(out, record_size);
-		writeByte(out, EFLAGS);
-		writeByte(out, Integer_2);
-		writeShort(out, Eflags);
-
-		record_size = 4 + SName.size();
-		if (record_size % 2 != 0)
-			record_size += 1;
-		writeShort(out, record_size);
-		writeByte(out, SNAME);
-		writeByte(out, String);
-		writeString(out, SName);
-
-		record_size = 6;
-		writeShort(out, record_size);
-		writeByte(out, STRANS);
-		writeByte(out, Integer_2);
-		writeShort(out, Strans);
-
-		record_size = 8;
-		writeShort(out, record_size);
-		writeByte(out, COLROW);
-		writeByte(out, Integer_2);
-		writeShort(out, Col);
-		writeShort(out, Row);
-
-		record_size = 28;
-		writeShort(out, record_size);
-		writeByte(out, XY);
-		writeByte(out, Integer_4);
-		for (int i = 0; i < 3; i++)
-		{
-			writeInteger(out, X[i]);
-			writeInteger(out, Y[i]);
-		}
-
-		record_size = 12;
-		writeShort(out, record_size);
-		writeByte(out, ANGLE);
-		writeByte(out, Real_8);
-		writeDouble(out, Angle);
-
-		record_size = 12;
-		writeShort(out, record_size);
-		writeByte(out, MAG);
-		writeByte(out, Real_8);
-		writeDouble(out, Mag);
-
-		record_size = 4;
-		writeShort(out, record_size);
-		writeByte(out, ENDEL);
-		writeByte(out, NoData);
+		writer.writeRecord(AREF);
+		writer.writeShort(EFLAGS, Eflags);
+		writer.writeString(SNAME, internedString(SName));
+		writer.writeShort(STRANS, Strans);
+		short colrow[2] = { Col, Row };
+		writer.writeShorts(COLROW, colrow, 2);
+		writer.writeXY(X.data(), Y.data(), 3);
+		writer.writeDouble(ANGLE, Angle);
+		writer.writeDouble(MAG, Mag);
+		writer.writeRecord(ENDEL);
 
 		return true;
 	}
@@ -371,7 +387,7 @@ namespace GDS
 	{
 		out << "AREF" << std::endl;
 		out << "EFLAGS " << Eflags << std::endl;
-		out << "SNAME " << SName << std::endl;
+		out << "SNAME " << internedString(SName) << std::endl;
 		out << "STRANS " << Strans << std::endl;
 		out << "COLROW " << Col << " " << Row << std::endl;
 		out << "XY ";
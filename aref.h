@@ -22,8 +22,11 @@
 #ifndef AREF_H
 #define AREF_H
 #include "elements.h"
+#include "stringtable.h"
+#include "geometry.h"
 
 namespace GDS {
+	class Structure;
 
 	/*!
 	 * \brief Class for 'AREF' GDSII element
@@ -41,18 +44,35 @@ namespace GDS {
 	 */
 	class ARef : public Element {
 		short               Eflags;
-		std::string         SName;
+		StringId            SName;
+		Structure* const*   Target;         //< Slot of the referenced structure in its library.
 		short               Strans;
 		short               Row, Col;
-		std::vector<int>    X, Y;
+		Coordinates         X, Y;
 		double              Angle;
 		double              Mag;
+		Transform           Placement;      //< Of the first instance, kept up to date.
+		double              Pitch[4];       //< Column x, y and row x, y displacements.
+
+		void place();
 
 	public:
 		ARef(Structure* parent = nullptr);
 		virtual ~ARef();
 
 		std::string structName() const;
+		StringId structNameId() const;
+		/*!
+		 * \brief The referenced structure.
+		 *
+		 * The reference is resolved when it is linked into a library, see
+		 * Library::link(). It follows later Library::add() and Library::del()
+		 * calls of the same name.
+		 *
+		 * \return	nullptr if the reference is not linked or the library has
+		 *			no structure of that name.
+		 */
+		Structure* target() const;
 		short row() const;
 		short col() const;
 		void xy(std::vector<int> &x, std::vector<int> &y) const;
@@ -60,8 +80,25 @@ namespace GDS {
 		double mag() const;
 		short strans() const;
 		bool stransFlag(STRANS_FLAG flag) const;
+		/*!
+		 * \brief Placement of one instance of the array.
+		 *
+		 * The ABS_MAG and ABS_ANGLE flags are not taken into account. The
+		 * placement of the first instance is built once when the element is
+		 * read or changed; the others are moved copies of it.
+		 *
+		 * \param [in] col, row		Position of the instance, from 0.
+		 */
+		Transform transform(int col = 0, int row = 0) const;
+		/*!
+		 * \brief Displacement between neighbouring instances.
+		 *
+		 * Both vectors are zero if the array is not complete.
+		 */
+		void pitch(double &col_x, double &col_y, double &row_x, double &row_y) const;
 
 		void setStructName(std::string name);
+		void setTarget(Structure* const* slot);
 		void setRowCol(int row,  int col);
 		void setXY(std::vector<int> &x, std::vector<int> &y);
 		void setAngle(double angle);
@@ -69,8 +106,8 @@ namespace GDS {
 		void setStrans(short strans);
 		void setStrans(STRANS_FLAG flag, bool enable = true);
 
-		virtual bool read(std::ifstream &in);
-		virtual bool write(std::ofstream &out);
+		virtual bool read(RecordReader &reader);
+		virtual bool write(RecordWriter &writer);
 		virtual bool printASCII(std::ofstream &out);
 	};
 
@@ -0,0 +1,91 @@
+/*
+ * This file is part of GDSII.
+ *
+ * arena.cpp -- The source file which defines the memory pool used for the
+ *              elements of a structure.
+ *
+ * Copyright (c) 2015 Kangpeng Shao <billowen035@gmail.com>
+ *
+ * GDSII is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at you option) any later version.
+ *
+ * GDSII is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABLILTY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GDSII. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#include <cstdint>
+#include "arena.h"
+
+namespace GDS
+{
+	// Blocks start small, since most structures hold a few elements, and
+	// double up to a limit.
+	static const size_t First_block = 1 << 12;
+	static const size_t Last_block = 1 << 20;
+
+	Arena::Arena()
+	{
+		Next = nullptr;
+		Left = 0;
+		Block_size = First_block;
+		Used = 0;
+		Users = 1;
+	}
+
+	Arena::~Arena()
+	{
+		for (char *block : Blocks)
+			delete[] block;
+	}
+
+	void* Arena::allocate(size_t size, size_t align)
+	{
+		size_t pad = (align - (uintptr_t)Next % align) % align;
+		if (Next == nullptr || pad + size > Left)
+		{
+			size_t block = Block_size;
+			if (Block_size < Last_block)
+				Block_size *= 2;
+			if (block < size + align)
+				block = size + align;
+			Next = new char[block];
+			Blocks.push_back(Next);
+			Left = block;
+			pad = (align - (uintptr_t)Next % align) % align;
+		}
+		void *p = Next + pad;
+		Next += pad + size;
+		Left -= pad + size;
+		Used += size;
+		return p;
+	}
+
+	void Arena::reserve(size_t size)
+	{
+		if (size > Left && size > Block_size)
+			Block_size = size;
+	}
+
+	size_t Arena::used() const
+	{
+		return Used;
+	}
+
+	void Arena::retain()
+	{
+		Users.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	void Arena::release()
+	{
+		if (Users.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			delete this;
+	}
+}
@@ -0,0 +1,128 @@
+/*
+ * This file is part of GDSII.
+ *
+ * arena.h -- The header file which declare the memory pool used for the
+ *            elements of a structure.
+ *
+ * Copyright (c) 2015 Kangpeng Shao <billowen035@gmail.com>
+ *
+ * GDSII is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at you option) any later version.
+ *
+ * GDSII is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABLILTY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GDSII. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef GDS_ARENA_H
+#define GDS_ARENA_H
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <vector>
+
+namespace GDS
+{
+	/*!
+	 * \brief Bump allocator whose memory is released all at once.
+	 *
+	 * Every structure owns an arena for its elements and their coordinates.
+	 * Single allocations are never returned; the blocks go back to the heap
+	 * when the last user of the arena releases it. Users are counted, so an
+	 * element may outlive the structure it was read into.
+	 *
+	 * Allocation is not thread-safe, but retain() and release() are.
+	 */
+	class Arena
+	{
+		std::vector<char*>  Blocks;
+		char*               Next;
+		size_t              Left;
+		size_t              Block_size;     //< Size of the next regular block.
+		size_t              Used;
+		std::atomic<long>   Users;
+
+		Arena(const Arena&);
+		Arena& operator=(const Arena&);
+		~Arena();
+
+	public:
+		/*!
+		 * Create an arena with one user, its creator.
+		 */
+		Arena();
+
+		void* allocate(size_t size, size_t align = alignof(std::max_align_t));
+		/*!
+		 * Make the next block large enough for size bytes, when the size of
+		 * the contents is known in advance.
+		 */
+		void reserve(size_t size);
+		/*!
+		 * Bytes handed out so far.
+		 */
+		size_t used() const;
+
+		void retain();
+		/*!
+		 * Drop one user. The arena deletes itself with the last one.
+		 */
+		void release();
+	};
+
+	/*!
+	 * \brief Standard allocator on top of an arena.
+	 *
+	 * Without an arena it falls back to the heap, so containers using it
+	 * behave as usual outside of a structure.
+	 */
+	template<class T>
+	class ArenaAllocator
+	{
+	public:
+		typedef T value_type;
+
+		Arena*  Pool;
+
+		ArenaAllocator(Arena *pool = nullptr) : Pool(pool) {}
+		template<class U>
+		ArenaAllocator(const ArenaAllocator<U> &other) : Pool(other.Pool) {}
+
+		T* allocate(size_t n)
+		{
+			if (Pool == nullptr)
+				return static_cast<T*>(::operator new(n * sizeof(T)));
+			return static_cast<T*>(Pool->allocate(n * sizeof(T), alignof(T)));
+		}
+
+		void deallocate(T *p, size_t)
+		{
+			if (Pool == nullptr)
+				::operator delete(p);
+		}
+
+		template<class U>
+		struct rebind { typedef ArenaAllocator<U> other; };
+	};
+
+	template<class T, class U>
+	bool operator==(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b)
+	{
+		return a.Pool == b.Pool;
+	}
+
+	template<class T, class U>
+	bool operator!=(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b)
+	{
+		return a.Pool != b.Pool;
+	}
+}
+
+#endif
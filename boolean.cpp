@@ -0,0 +1,459 @@
+/*
+ * This file is part of GDSII.
+ *
+ * boolean.cpp -- The source file which defines the boolean operations on
+ *                polygon sets.
+ *
+ * Copyright (c) 2015 Kangpeng Shao <billowen035@gmail.com>
+ *
+ * GDSII is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at you option) any later version.
+ *
+ * GDSII is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABLILTY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GDSII. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "boolean.h"
+#include "parallel.h"
+
+namespace GDS
+{
+#if defined(__SIZEOF_INT128__)
+	typedef __int128 Wide;
+
+	// Floor of n / d for d > 0.
+	static Wide floorDiv(Wide n, Wide d)
+	{
+		Wide q = n / d;
+		if (n % d != 0 && n < 0)
+			q--;
+		return q;
+	}
+#else
+	// Without 128-bit integers the products lose their last bits beyond
+	// 64 bits of mantissa.
+	typedef long double Wide;
+
+	static Wide floorDiv(Wide n, Wide d)
+	{
+		return std::floor(n / d);
+	}
+#endif
+
+	// A non-horizontal polygon edge, from bottom to top.
+	struct BooleanEdge
+	{
+		int     X0, Y0, X1, Y1;
+		int     Winding;        // +1 where the sweep enters the polygon.
+		int     Operand;        // 0 or 1.
+	};
+
+	// x of an edge at y = y2 / q, as numerator / denominator with a
+	// positive denominator.
+	static void xAt(const BooleanEdge &e, long long y2, long long q, Wide &num, Wide &den)
+	{
+		Wide dy = (Wide)e.Y1 - e.Y0;
+		num = (Wide)e.X0 * dy * q + ((Wide)e.X1 - e.X0) * ((Wide)y2 - (Wide)e.Y0 * q);
+		den = dy * q;
+	}
+
+	// -1, 0 or 1 as a is left of, at or right of b at y = y2 / q.
+	static int compareAt(const BooleanEdge &a, const BooleanEdge &b, long long y2, long long q)
+	{
+		if (a.X0 == a.X1 && b.X0 == b.X1)
+			return (a.X0 > b.X0) - (a.X0 < b.X0);
+		Wide na, da, nb, db;
+		xAt(a, y2, q, na, da);
+		xAt(b, y2, q, nb, db);
+		Wide l = na * db, r = nb * da;
+		return (l > r) - (l < r);
+	}
+
+	static int roundedX(const BooleanEdge &e, int y)
+	{
+		if (e.X0 == e.X1)
+			return e.X0;
+		Wide num, den;
+		xAt(e, y, 1, num, den);
+		Wide x = floorDiv(2 * num + den, 2 * den);
+		if (x < std::numeric_limits<int>::min())
+			return std::numeric_limits<int>::min();
+		if (x > std::numeric_limits<int>::max())
+			return std::numeric_limits<int>::max();
+		return (int)x;
+	}
+
+	// Floor of the y where two edges cross, which must not be parallel.
+	static long long crossingFloor(const BooleanEdge &a, const BooleanEdge &b)
+	{
+		Wide dxa = (Wide)a.X1 - a.X0, dya = (Wide)a.Y1 - a.Y0;
+		Wide dxb = (Wide)b.X1 - b.X0, dyb = (Wide)b.Y1 - b.Y0;
+		Wide n = dxa * dyb * a.Y0 - dxb * dya * b.Y0 - ((Wide)a.X0 - b.X0) * dya * dyb;
+		Wide d = dxa * dyb - dxb * dya;
+		if (d < 0)
+		{
+			n = -n;
+			d = -d;
+		}
+		return (long long)floorDiv(n, d);
+	}
+
+	// Convert the polygons of a set to edges, each polygon made
+	// counterclockwise so that the windings of overlapping polygons add up.
+	static void collectEdges(const PolygonSet &set, int operand, std::vector<BooleanEdge> &edges)
+	{
+		for (size_t i = 0; i < set.size(); i++)
+		{
+			PointRange points = set.get(i);
+			double twice = 0;
+			for (size_t k = 1; k + 1 < points.Count; k++)
+			{
+				double ax = (double)points.X[k] - points.X[0], ay = (double)points.Y[k] - points.Y[0];
+				double bx = (double)points.X[k + 1] - points.X[0], by = (double)points.Y[k + 1] - points.Y[0];
+				twice += ax * by - ay * bx;
+			}
+			if (twice == 0)
+				continue;
+			int orientation = twice > 0 ? 1 : -1;
+			for (size_t k = 0; k < points.Count; k++)
+			{
+				size_t next = k + 1 == points.Count ? 0 : k + 1;
+				int x0 = points.X[k], y0 = points.Y[k], x1 = points.X[next], y1 = points.Y[next];
+				if (y0 == y1)
+					continue;
+				BooleanEdge edge;
+				edge.Operand = operand;
+				// Downward edges are on the left of a counterclockwise polygon.
+				edge.Winding = (y1 < y0 ? 1 : -1) * orientation;
+				if (y0 < y1)
+				{
+					edge.X0 = x0; edge.Y0 = y0; edge.X1 = x1; edge.Y1 = y1;
+				}
+				else
+				{
+					edge.X0 = x1; edge.Y0 = y1; edge.X1 = x0; edge.Y1 = y0;
+				}
+				edges.push_back(edge);
+			}
+		}
+	}
+
+	// Sweeps the edges of one band of the plane.
+	struct BooleanSweep
+	{
+		struct Trapezoid
+		{
+			int     Left, Right;        // Edges.
+			int     Bottom, Top;
+			int     Left_bottom, Right_bottom, Left_top, Right_top;
+			bool    Extended;
+		};
+
+		const std::vector<BooleanEdge>  &Edges;     // Sorted by Y0.
+		Boolean_op                      Op;
+		bool                            Rectilinear;
+		PolygonSet                      &Out;
+		std::vector<int>                Active;
+		std::vector<Trapezoid>          Open, Next;
+		std::vector<int>                Open_by_left;   // Edge to position in Open, or -1.
+
+		BooleanSweep(const std::vector<BooleanEdge> &edges, Boolean_op op, bool rectilinear, PolygonSet &out)
+			: Edges(edges), Op(op), Rectilinear(rectilinear), Out(out), Open_by_left(edges.size(), -1) {}
+
+		bool inside(int wa, int wb) const
+		{
+			bool a = wa != 0, b = wb != 0;
+			switch (Op)
+			{
+			case BOOLEAN_OR:
+				return a || b;
+			case BOOLEAN_AND:
+				return a && b;
+			case BOOLEAN_XOR:
+				return a != b;
+			case BOOLEAN_NOT:
+				return a && !b;
+			}
+			return false;
+		}
+
+		void flush(const Trapezoid &t)
+		{
+			int xs[4] = { t.Left_bottom, t.Right_bottom, t.Right_top, t.Left_top };
+			int ys[4] = { t.Bottom, t.Bottom, t.Top, t.Top };
+			// Edges crossing in a snapped row may leave the sides swapped.
+			if (xs[0] > xs[1])
+				std::swap(xs[0], xs[1]);
+			if (xs[3] > xs[2])
+				std::swap(xs[2], xs[3]);
+			int px[4], py[4];
+			size_t n = 0;
+			for (int k = 0; k < 4; k++)
+			{
+				if (n > 0 && xs[k] == px[n - 1] && ys[k] == py[n - 1])
+					continue;
+				px[n] = xs[k];
+				py[n] = ys[k];
+				n++;
+			}
+			if (n > 1 && px[0] == px[n - 1] && py[0] == py[n - 1])
+				n--;
+			Out.add(px, py, n);
+		}
+
+		void span(int left, int right, int bottom, int top, bool joinable)
+		{
+			Trapezoid t;
+			t.Left = left;
+			t.Right = right;
+			t.Bottom = bottom;
+			t.Top = top;
+			t.Left_bottom = roundedX(Edges[left], bottom);
+			t.Right_bottom = roundedX(Edges[right], bottom);
+			t.Left_top = roundedX(Edges[left], top);
+			t.Right_top = roundedX(Edges[right], top);
+			t.Extended = false;
+			if (t.Left_bottom == t.Right_bottom && t.Left_top == t.Right_top)
+				return;
+			if (!joinable)
+			{
+				flush(t);
+				return;
+			}
+			int open = Open_by_left[left];
+			if (open >= 0 && Open[open].Right == right && Open[open].Top == bottom && !Open[open].Extended)
+			{
+				Open[open].Extended = true;
+				t.Bottom = Open[open].Bottom;
+				t.Left_bottom = Open[open].Left_bottom;
+				t.Right_bottom = Open[open].Right_bottom;
+			}
+			Next.push_back(t);
+		}
+
+		// Pass on the trapezoids which the last slab did not extend, and
+		// make the ones of the last slab the open ones.
+		void advance()
+		{
+			for (const Trapezoid &t : Open)
+			{
+				Open_by_left[t.Left] = -1;
+				if (!t.Extended)
+					flush(t);
+			}
+			Open.swap(Next);
+			Next.clear();
+			for (size_t i = 0; i < Open.size(); i++)
+				Open_by_left[Open[i].Left] = (int)i;
+		}
+
+		// Sort the active edges at y = y2 / q, then at y = tie2 / tie_q.
+		void sortActive(long long y2, long long q, long long tie2, long long tie_q)
+		{
+			auto less = [&](int a, int b)
+			{
+				int c = compareAt(Edges[a], Edges[b], y2, q);
+				if (c != 0)
+					return c < 0;
+				c = compareAt(Edges[a], Edges[b], tie2, tie_q);
+				if (c != 0)
+					return c < 0;
+				return a < b;
+			};
+			if (Rectilinear)
+			{
+				insertionSort([&](int a, int b)
+				{
+					return Edges[a].X0 < Edges[b].X0 || (Edges[a].X0 == Edges[b].X0 && a < b);
+				});
+			}
+			else
+			{
+				insertionSort(less);
+			}
+		}
+
+		// The order changes little from slab to slab.
+		template<typename Less>
+		void insertionSort(Less less)
+		{
+			for (size_t i = 1; i < Active.size(); i++)
+			{
+				int e = Active[i];
+				size_t j = i;
+				for (; j > 0 && less(e, Active[j - 1]); j--)
+					Active[j] = Active[j - 1];
+				Active[j] = e;
+			}
+		}
+
+		void run(int low, int high)
+		{
+			size_t next = 0;
+			long long bottom = low;
+			while (bottom < high)
+			{
+				// Drop the edges which end, take the edges which start.
+				size_t kept = 0;
+				for (int e : Active)
+				{
+					if (Edges[e].Y1 > bottom)
+						Active[kept++] = e;
+				}
+				Active.resize(kept);
+				if (Active.empty() && next < Edges.size() && Edges[next].Y0 > bottom)
+				{
+					advance();
+					bottom = std::min<long long>(Edges[next].Y0, high);
+					continue;
+				}
+				while (next < Edges.size() && Edges[next].Y0 <= bottom)
+				{
+					if (Edges[next].Y1 > bottom)
+						Active.push_back((int)next);
+					next++;
+				}
+				if (Active.empty())
+					break;
+
+				long long top = high;
+				if (next < Edges.size())
+					top = std::min<long long>(top, Edges[next].Y0);
+				for (int e : Active)
+					top = std::min<long long>(top, Edges[e].Y1);
+
+				sortActive(bottom, 1, top, 1);
+				bool joinable = true;
+				if (!Rectilinear)
+				{
+					// The first crossing above the bottom is between
+					// neighbours at the bottom.
+					long long first = top;
+					for (size_t i = 0; i + 1 < Active.size(); i++)
+					{
+						const BooleanEdge &a = Edges[Active[i]], &b = Edges[Active[i + 1]];
+						if (compareAt(a, b, top, 1) > 0)
+							first = std::min(first, crossingFloor(a, b));
+					}
+					if (first < top)
+					{
+						if (first > bottom)
+						{
+							top = first;
+						}
+						else
+						{
+							// The crossing is in the unit row above the bottom.
+							top = bottom + 1;
+							sortActive(2 * bottom + 1, 2, 2 * bottom + 1, 2);
+							joinable = false;
+						}
+					}
+				}
+
+				int wa = 0, wb = 0, left = -1;
+				bool in = false;
+				for (int e : Active)
+				{
+					if (Edges[e].Operand == 0)
+						wa += Edges[e].Winding;
+					else
+						wb += Edges[e].Winding;
+					bool now = inside(wa, wb);
+					if (now && !in)
+						left = e;
+					else if (!now && in)
+						span(left, e, (int)bottom, (int)top, joinable);
+					in = now;
+				}
+				advance();
+				bottom = top;
+			}
+			advance();
+		}
+	};
+
+	BooleanEngine::BooleanEngine(int threads)
+	{
+		Threads = threads;
+	}
+
+	void BooleanEngine::setThreads(int threads)
+	{
+		Threads = threads;
+	}
+
+	void BooleanEngine::run(const PolygonSet &a, const PolygonSet &b, Boolean_op op, PolygonSet &out) const
+	{
+		std::vector<BooleanEdge> edges;
+		edges.reserve(a.vertexCount() + b.vertexCount());
+		collectEdges(a, 0, edges);
+		collectEdges(b, 1, edges);
+		if (edges.empty())
+			return;
+		std::sort(edges.begin(), edges.end(), [](const BooleanEdge &l, const BooleanEdge &r)
+		{
+			return l.Y0 < r.Y0;
+		});
+		bool rectilinear = true;
+		int low = edges[0].Y0, high = edges[0].Y1;
+		for (const BooleanEdge &e : edges)
+		{
+			rectilinear = rectilinear && e.X0 == e.X1;
+			high = std::max(high, e.Y1);
+		}
+
+		int threads = Threads <= 0 ? defaultThreads() : Threads;
+		// Bands of fewer edges than this are not worth a thread.
+		const size_t band_edges = 4096;
+		size_t bands = std::min((size_t)threads * 4, edges.size() / band_edges);
+		if (threads <= 1 || bands <= 1)
+		{
+			BooleanSweep sweep(edges, op, rectilinear, out);
+			sweep.run(low, high);
+			return;
+		}
+
+		// Band borders at the quantiles of the edge starts.
+		std::vector<int> borders(1, low);
+		for (size_t i = 1; i < bands; i++)
+		{
+			int y = edges[edges.size() * i / bands].Y0;
+			if (y > borders.back())
+				borders.push_back(y);
+		}
+		borders.push_back(high);
+		std::vector<PolygonSet> results(borders.size() - 1);
+		parallelFor(results.size(), threads, [&](size_t i)
+		{
+			int band_low = borders[i], band_high = borders[i + 1];
+			std::vector<BooleanEdge> band;
+			for (const BooleanEdge &e : edges)
+			{
+				if (e.Y0 >= band_high)
+					break;
+				if (e.Y1 > band_low)
+					band.push_back(e);
+			}
+			BooleanSweep sweep(band, op, rectilinear, results[i]);
+			sweep.run(band_low, band_high);
+		});
+		for (const PolygonSet &result : results)
+			out.append(result);
+	}
+
+	void BooleanEngine::merge(const PolygonSet &a, PolygonSet &out) const
+	{
+		run(a, PolygonSet(), BOOLEAN_OR, out);
+	}
+}
@@ -0,0 +1,92 @@
+/*
+ * This file is part of GDSII.
+ *
+ * boolean.h -- The header file which declare the boolean operations on
+ *              polygon sets.
+ *
+ * Copyright (c) 2015 Kangpeng Shao <billowen035@gmail.com>
+ *
+ * GDSII is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at you option) any later version.
+ *
+ * GDSII is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABLILTY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GDSII. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef GDS_BOOLEAN_H
+#define GDS_BOOLEAN_H
+
+#include "polygons.h"
+
+namespace GDS
+{
+	enum Boolean_op
+	{
+		BOOLEAN_OR,
+		BOOLEAN_AND,
+		BOOLEAN_XOR,
+		BOOLEAN_NOT,        //< The first operand without the second.
+	};
+
+	/*!
+	 * \brief Boolean operations on polygon sets by a sweep line.
+	 *
+	 * The polygons are cut into slabs at the y of every vertex and every
+	 * edge crossing, and each slab is walked from left to right, counting
+	 * the winding of both operands. A point is inside an operand if it is
+	 * inside any of its polygons, whatever their orientation.
+	 *
+	 * The positions of the edges are compared exactly, as fractions of
+	 * 128-bit integers. Crossings are snapped to the grid in y: the slab
+	 * below a crossing ends on the unit row holding it, and that row is
+	 * ordered at its middle. Rectilinear input never crosses, so it is
+	 * swept without those checks and the output is exact.
+	 *
+	 * The result is a set of disjoint trapezoids with horizontal top and
+	 * bottom sides, in counterclockwise order; rectilinear input gives
+	 * rectangles. Trapezoids of consecutive slabs between the same two
+	 * edges are joined.
+	 *
+	 * With several threads, the plane is cut into horizontal bands of
+	 * about equal edge counts which are swept in parallel. Trapezoids are
+	 * not joined across the band borders.
+	 *
+	 * \code
+	 *  PolygonSet a, b, out;
+	 *  a.addBoundaries(*cell->layers().find(1, 0));
+	 *  BooleanEngine().run(a, b, BOOLEAN_XOR, out);
+	 * \endcode
+	 */
+	class BooleanEngine
+	{
+		int         Threads;
+
+	public:
+		/*!
+		 * \param [in] threads		Number of threads, 0 for defaultThreads().
+		 */
+		BooleanEngine(int threads = 1);
+
+		void setThreads(int threads);
+
+		/*!
+		 * \brief Compute a op b.
+		 *
+		 * \param [out] out		The trapezoids of the result are appended.
+		 */
+		void run(const PolygonSet &a, const PolygonSet &b, Boolean_op op, PolygonSet &out) const;
+		/*!
+		 * \brief Merge the overlapping polygons of a set.
+		 */
+		void merge(const PolygonSet &a, PolygonSet &out) const;
+	};
+}
+
+#endif
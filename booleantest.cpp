@@ -0,0 +1,216 @@
+/*
+ * This file is part of GDSII.
+ *
+ * booleantest.cpp -- Tests of the polygon boolean engine against a raster.
+ *
+ * Copyright (c) 2015 Kangpeng Shao <billowen035@gmail.com>
+ *
+ * GDSII is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at you option) any later version.
+ *
+ * GDSII is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABLILTY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GDSII. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "boolean.h"
+
+using namespace GDS;
+
+static int Failures = 0;
+
+static void fail(const std::string &what, int round)
+{
+    Failures++;
+    if (Failures <= 20)
+        std::cout << "FAIL " << what << " in round " << round << std::endl;
+}
+
+static unsigned int Seed = 3;
+
+static int random(int n)
+{
+    Seed = Seed * 1103515245 + 12345;
+    return (int)((Seed >> 16) % (unsigned int)n);
+}
+
+static const int Grid = 16;
+
+/*
+ * Whether the centre of unit cell (cx, cy) is inside a polygon, by the
+ * crossings of a ray to the right. The centre is never on an edge.
+ **/
+static bool inside(const PointRange &polygon, int cx, int cy)
+{
+    double x = cx + 0.5, y = cy + 0.5;
+    bool in = false;
+    for (size_t i = 0, j = polygon.Count - 1; i < polygon.Count; j = i++)
+    {
+        double xi = polygon.X[i], yi = polygon.Y[i], xj = polygon.X[j], yj = polygon.Y[j];
+        if ((yi > y) != (yj > y) && x < xi + (y - yi) * (xj - xi) / (yj - yi))
+            in = !in;
+    }
+    return in;
+}
+
+/*
+ * How many polygons of the set cover every unit cell.
+ **/
+static std::vector<int> raster(const PolygonSet &set)
+{
+    std::vector<int> cover(Grid * Grid, 0);
+    for (size_t p = 0; p < set.size(); p++)
+    {
+        PointRange polygon = set.get(p);
+        for (int cy = 0; cy < Grid; cy++)
+        {
+            for (int cx = 0; cx < Grid; cx++)
+            {
+                if (inside(polygon, cx, cy))
+                    cover[cy * Grid + cx]++;
+            }
+        }
+    }
+    return cover;
+}
+
+/*
+ * A rectangle or an L of random orientation, both ways round.
+ **/
+static void addPolygon(PolygonSet &set)
+{
+    int x0 = random(Grid - 1), y0 = random(Grid - 1);
+    int x1 = x0 + 1 + random(Grid - x0), y1 = y0 + 1 + random(Grid - y0);
+    std::vector<int> x, y;
+    if (random(3) == 0 || x1 - x0 < 2 || y1 - y0 < 2)
+    {
+        x = {x0, x1, x1, x0};
+        y = {y0, y0, y1, y1};
+    }
+    else
+    {
+        // Cut a corner out of the rectangle.
+        int xm = x0 + 1 + random(x1 - x0 - 1), ym = y0 + 1 + random(y1 - y0 - 1);
+        switch (random(4))
+        {
+        case 0: x = {x0, x1, x1, xm, xm, x0}; y = {y0, y0, ym, ym, y1, y1}; break;
+        case 1: x = {x0, xm, xm, x1, x1, x0}; y = {y0, y0, ym, ym, y1, y1}; break;
+        case 2: x = {x0, x1, x1, xm, xm, x0}; y = {y0, y0, y1, y1, ym, ym}; break;
+        default: x = {xm, x1, x1, x0, x0, xm}; y = {y0, y0, y1, y1, ym, ym}; break;
+        }
+    }
+    if (random(2))
+    {
+        std::vector<int> rx(x.rbegin(), x.rend()), ry(y.rbegin(), y.rend());
+        x.swap(rx);
+        y.swap(ry);
+    }
+    set.add(x.data(), y.data(), x.size());
+}
+
+static bool expected(Boolean_op op, bool a, bool b)
+{
+    switch (op)
+    {
+    case BOOLEAN_OR: return a || b;
+    case BOOLEAN_AND: return a && b;
+    case BOOLEAN_XOR: return a != b;
+    default: return a && !b;
+    }
+}
+
+static bool isRectangle(const PointRange &polygon)
+{
+    if (polygon.Count != 4)
+        return false;
+    for (size_t i = 0; i < 4; i++)
+    {
+        size_t j = (i + 1) % 4;
+        if ((polygon.X[i] == polygon.X[j]) == (polygon.Y[i] == polygon.Y[j]))
+            return false;
+    }
+    return true;
+}
+
+/*
+ * The result covers exactly the expected cells, each once, with
+ * rectangles.
+ **/
+static void checkResult(const std::vector<int> &a, const std::vector<int> &b, Boolean_op op,
+    const PolygonSet &out, const std::string &what, int round)
+{
+    std::vector<int> cover = raster(out);
+    size_t cells = 0;
+    for (int i = 0; i < Grid * Grid; i++)
+    {
+        bool want = expected(op, a[i] > 0, b[i] > 0);
+        cells += want ? 1 : 0;
+        if (cover[i] != (want ? 1 : 0))
+        {
+            fail(what, round);
+            return;
+        }
+    }
+    if (std::fabs(out.area() - (double)cells) > 1e-9)
+        fail(what + " area", round);
+    for (size_t p = 0; p < out.size(); p++)
+    {
+        if (!isRectangle(out.get(p)))
+        {
+            fail(what + " rectangles", round);
+            return;
+        }
+    }
+}
+
+static void testRectilinear()
+{
+    const char *names[] = {"OR", "AND", "XOR", "NOT"};
+    for (int round = 0; round < 5000; round++)
+    {
+        PolygonSet a, b;
+        int count_a = random(5), count_b = random(5);
+        for (int i = 0; i < count_a; i++)
+            addPolygon(a);
+        for (int i = 0; i < count_b; i++)
+            addPolygon(b);
+        std::vector<int> raster_a = raster(a), raster_b = raster(b);
+
+        for (int threads = 1; threads <= 3; threads += 2)
+        {
+            BooleanEngine engine(threads);
+            std::string suffix = threads > 1 ? " on threads" : "";
+            for (int op = BOOLEAN_OR; op <= BOOLEAN_NOT; op++)
+            {
+                PolygonSet out;
+                engine.run(a, b, (Boolean_op)op, out);
+                checkResult(raster_a, raster_b, (Boolean_op)op, out, names[op] + suffix, round);
+            }
+            PolygonSet merged;
+            engine.merge(a, merged);
+            checkResult(raster_a, std::vector<int>(Grid * Grid, 0), BOOLEAN_OR, merged, "merge" + suffix, round);
+        }
+    }
+}
+
+int main()
+{
+    testRectilinear();
+    if (Failures > 0)
+    {
+        std::cout << Failures << " failures" << std::endl;
+        return 1;
+    }
+    std::cout << "all passed" << std::endl;
+    return 0;
+}
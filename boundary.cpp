@@ -30,7 +30,7 @@
 namespace GDS
 {
 
-	Boundary::Boundary(Structure* parent) :Element(BOUNDARY, parent)
+	Boundary::Boundary(Structure* parent) :Element(BOUNDARY, parent), X(storage()), Y(storage())
 	{
 		Eflags = 0;
 		Layer = -1;
@@ -52,39 +52,68 @@ namespace GDS
 		return Data_type;
 	}
 
+	size_t Boundary::pointCount() const
+	{
+		return X.size();
+	}
+
+	const int* Boundary::xData() const
+	{
+		return X.data();
+	}
+
+	const int* Boundary::yData() const
+	{
+		return Y.data();
+	}
+
 	void Boundary::xy(std::vector<int> &x, std::vector<int> &y) const
 	{
-		x = X;
-		y = Y;
+		x.assign(X.begin(), X.end());
+		y.assign(Y.begin(), Y.end());
+	}
+
+	Box Boundary::bbox() const
+	{
+		Box box;
+		for (size_t i = 0; i < X.size(); i++)
+			box.add(X[i], Y[i]);
+		return box;
 	}
 
 	void Boundary::setLayer(short layer)
 	{
 		Layer = layer;
+		touch();
 	}
 
 	void Boundary::setDataType(short data_type)
 	{
 		Data_type = data_type;
+		touch();
 	}
 
 	void Boundary::setXY(std::vector<int> &x, std::vector<int> &y)
 	{
-		X = x;
-		Y = y;
+		X.assign(x.begin(), x.end());
+		Y.assign(y.begin(), y.end());
+		touch();
 	}
 
-	bool Boundary::read(std::ifstream &in)
+	bool Boundary::read(RecordReader &reader)
 	{
 #ifdef _DEBUG_LOG
         LogIO* log = LogIO::getInstance();
 #endif
+		const Record &rec = reader.record();
 		bool finished = false;
 		while (!finished)
 		{
-			short record_size = readShort(in);
-			Byte record_type = readByte(in);
-			Byte data_type = readByte(in);
+			if (!reader.next())
+				throw FormatError("unexpected end of file in BOUNDARY.");
+			int record_size = rec.size;
+			Byte record_type = rec.record_type;
+			Byte data_type = rec.data_type;
 			switch (record_type)
 			{
 			case ENDEL:
@@ -107,7 +136,7 @@ namespace GDS
 					std::string msg = ss.str();
 					throw FormatError(msg);
 				}
-				Eflags = readShort(in);
+				Eflags = rec.getShort();
 #ifdef _DEBUG_LOG
                 {
                     std::stringstream ss;
@@ -126,7 +155,7 @@ namespace GDS
 					std::string msg = ss.str();
 					throw FormatError(msg);
 				}
-				Layer = readShort(in);
+				Layer = rec.getShort();
 #ifdef _DEBUG_LOG
                 {
                     std::stringstream ss;
@@ -145,7 +174,7 @@ namespace GDS
 					std::string msg = ss.str();
 					throw FormatError(msg);
 				}
-				Data_type = readShort(in);
+				Data_type = rec.getShort();
 #ifdef _DEBUG_LOG
                 {
                     std::stringstream ss;
@@ -167,13 +196,10 @@ namespace GDS
 					std::string msg = ss.str();
 					throw FormatError(msg);
 				}
-				for (int i = 0; i < num; i++)
-				{
-					int x = readInteger(in);
-					int y = readInteger(in);
-					X.push_back(x);
-					Y.push_back(y);
-				}
+				size_t begin = X.size();
+				X.resize(begin + num);
+				Y.resize(begin + num);
+				decodeXY(rec.data, num, &X[begin], &Y[begin]);
 #ifdef _DEBUG_LOG
                 {
                     std::stringstream ss;
@@ -196,47 +222,14 @@ namespace GDS
 		return true;
 	}
 
-	bool Boundary::write(std::ofstream &out)
+	bool Boundary::write(RecordWriter &writer)
 	{
-		short record_size;
-
-		record_size = 4;
-		writeShort(out, record_size);
-		writeByte(out, BOUNDARY);
-		writeByte(out, NoData);
-
-		record_size = 6;
-		writeShort(out, record_size);
-		writeByte(out, EFLAGS);
-		writeByte(out, Integer_2);
-		writeShort(out, Eflags);
-
-		record_size = 6;
-		writeShort(out, record_size);
-		writeByte(out, LAYER);
-		writeByte(out, Integer_2);
-		writeShort(out, Layer);
-
-		record_size = 6;
-		writeShort(out, record_size);
-		writeByte(out, DATATYPE);
-		writeByte(out, Integer_2);
-		writeShort(out, Data_type);
-
-		record_size = 4 + 8 * X.size();
-		writeShort(out, record_size);
-		writeByte(out, XY);
-		writeByte(out, Integer_4);
-		for (size_t i = 0; i < X.size(); i++)
-		{
-			writeInteger(out, X[i]);
-			writeInteger(out, Y[i]);
-		}
-
-		record_size = 4;
-		writeShort(out, record_size);
-		writeByte(out, ENDEL);
-		writeByte(out, NoData);
+		writer.writeRecord(BOUNDARY);
+		writer.writeShort(EFLAGS, Eflags);
+		writer.writeShort(LAYER, Layer);
+		writer.writeShort(DATATYPE, Data_type);
+		writer.writeXY(X.data(), Y.data(), (int)X.size());
+		writer.writeRecord(ENDEL);
 
 		return true;
 	}
@@ -22,6 +22,7 @@
 #ifndef BOUNDARY_H
 #define BOUNDARY_H
 #include "elements.h"
+#include "geometry.h"
 
 namespace GDS {
 
@@ -41,7 +42,7 @@ namespace GDS {
 		short               Eflags;         //< 2 bytes of bit flags. Not support yet.
 		short               Layer;
 		short               Data_type;
-		std::vector<int>    X, Y;
+		Coordinates         X, Y;
 
 	public:
 		Boundary(Structure *parent = nullptr);
@@ -49,14 +50,21 @@ namespace GDS {
 
 		short layer() const;
 		short dataType() const;
+		size_t pointCount() const;
+		const int* xData() const;
+		const int* yData() const;
 		void xy(std::vector<int> &x, std::vector<int> &y)const;
+		/*!
+		 * Box of the vertices.
+		 */
+		Box bbox() const;
 
 		void setLayer(short layer);
 		void setDataType(short data_type);
 		void setXY(std::vector<int> &x, std::vector<int> &y);
 
-		virtual bool read(std::ifstream &in);
-		virtual bool write(std::ofstream &out);
+		virtual bool read(RecordReader &reader);
+		virtual bool write(RecordWriter &writer);
 		virtual bool printASCII(std::ofstream &out);
 	};
 
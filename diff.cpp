@@ -0,0 +1,400 @@
+/*
+ * This file is part of GDSII.
+ *
+ * diff.cpp -- The source file which defines the geometric comparison of
+ *             two layouts.
+ *
+ * Copyright (c) 2015 Kangpeng Shao <billowen035@gmail.com>
+ *
+ * GDSII is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at you option) any later version.
+ *
+ * GDSII is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABLILTY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GDSII. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+#include "diff.h"
+#include "aref.h"
+#include "boolean.h"
+#include "boundary.h"
+#include "flatten.h"
+#include "hierarchy.h"
+#include "library.h"
+#include "parallel.h"
+#include "path.h"
+#include "sref.h"
+#include "text.h"
+
+namespace GDS
+{
+	// Placement of an SREF, without the contents of its structure.
+	struct DiffPlacement
+	{
+		StringId    Name;
+		short       Strans;
+		double      Mag;
+		double      Angle;
+		int         X, Y;
+
+		DiffPlacement(SRef &node)
+		{
+			Name = node.structNameId();
+			Strans = node.strans();
+			Mag = node.mag();
+			Angle = node.angle();
+			node.xy(X, Y);
+		}
+
+		bool operator<(const DiffPlacement &other) const
+		{
+			return std::tie(Name, Strans, Mag, Angle, X, Y)
+				< std::tie(other.Name, other.Strans, other.Mag, other.Angle, other.X, other.Y);
+		}
+	};
+
+	// Finds the boxes, in top coordinates, of the elements which differ
+	// between two hierarchies.
+	struct DiffPairing
+	{
+		std::vector<Box>        Changed;
+		std::vector<Structure*> Stack;      // Pairs being compared, side by side.
+		StructureComparer       Same;       // Confirms equal hashes.
+
+		void leave(Structure *cell, size_t index, const Transform &placement)
+		{
+			Box box = elementBox(cell->get((int)index));
+			if (!box.empty())
+				Changed.push_back(placement.apply(box));
+		}
+
+		void leaveAll(Structure *cell, const Transform &placement)
+		{
+			for (size_t i = 0; i < cell->size(); i++)
+			{
+				if (cell->get((int)i) != nullptr)
+					leave(cell, i, placement);
+			}
+		}
+
+		void pair(Structure *a, Structure *b, const Transform &placement)
+		{
+			if (a == nullptr || b == nullptr)
+			{
+				if (a != nullptr)
+					leaveAll(a, placement);
+				if (b != nullptr)
+					leaveAll(b, placement);
+				return;
+			}
+			if (Same.equal(a, b))
+				return;
+			for (size_t i = 0; i < Stack.size(); i += 2)
+			{
+				if (Stack[i] == a || Stack[i + 1] == b)
+				{
+					leaveAll(a, placement);
+					leaveAll(b, placement);
+					return;
+				}
+			}
+			Stack.push_back(a);
+			Stack.push_back(b);
+
+			// Cancel the elements equal on both sides. Equal hashes only
+			// pick the candidates.
+			std::unordered_map<unsigned long long, std::vector<size_t> > equal;
+			std::vector<char> left_a(a->size(), 0), left_b(b->size(), 0);
+			for (size_t i = 0; i < a->size(); i++)
+			{
+				Element *e = a->get((int)i);
+				if (e == nullptr)
+					continue;
+				equal[elementHash(e)].push_back(i);
+				left_a[i] = 1;
+			}
+			for (size_t i = 0; i < b->size(); i++)
+			{
+				Element *e = b->get((int)i);
+				if (e == nullptr)
+					continue;
+				auto found = equal.find(elementHash(e));
+				if (found != equal.end())
+				{
+					std::vector<size_t> &candidates = found->second;
+					size_t k = 0;
+					while (k < candidates.size() && !Same.equal(a->get((int)candidates[k]), e))
+						k++;
+					if (k < candidates.size())
+					{
+						left_a[candidates[k]] = 0;
+						candidates[k] = candidates.back();
+						candidates.pop_back();
+						continue;
+					}
+				}
+				left_b[i] = 1;
+			}
+
+			// Compare below the SREFs placed alike on both sides.
+			std::map<DiffPlacement, std::vector<size_t> > placed;
+			for (size_t i = 0; i < a->size(); i++)
+			{
+				Element *e = a->get((int)i);
+				if (left_a[i] && e->tag() == SREF && static_cast<SRef*>(e)->target() != nullptr)
+					placed[DiffPlacement(*static_cast<SRef*>(e))].push_back(i);
+			}
+			for (size_t i = 0; i < b->size(); i++)
+			{
+				Element *e = b->get((int)i);
+				if (!left_b[i] || e->tag() != SREF || static_cast<SRef*>(e)->target() == nullptr)
+					continue;
+				auto found = placed.find(DiffPlacement(*static_cast<SRef*>(e)));
+				if (found == placed.end() || found->second.empty())
+					continue;
+				SRef *ref_a = static_cast<SRef*>(a->get((int)found->second.back()));
+				SRef *ref_b = static_cast<SRef*>(e);
+				left_a[found->second.back()] = 0;
+				left_b[i] = 0;
+				found->second.pop_back();
+				pair(ref_a->target(), ref_b->target(), placement * ref_a->transform());
+			}
+
+			for (size_t i = 0; i < left_a.size(); i++)
+			{
+				if (left_a[i])
+					leave(a, i, placement);
+			}
+			for (size_t i = 0; i < left_b.size(); i++)
+			{
+				if (left_b[i])
+					leave(b, i, placement);
+			}
+			Stack.resize(Stack.size() - 2);
+		}
+	};
+
+	// Load a structure and everything below it, with the boxes and spatial
+	// indices of a windowed walk, so the tiles only read.
+	static void prepare(Structure *structure, std::unordered_set<Structure*> &seen)
+	{
+		std::vector<Structure*> pending(1, structure);
+		if (!seen.insert(structure).second)
+			return;
+		while (!pending.empty())
+		{
+			Structure *cell = pending.back();
+			pending.pop_back();
+			cell->spatial();
+			cell->bbox();
+			for (Structure *child : cell->children())
+			{
+				if (seen.insert(child).second)
+					pending.push_back(child);
+			}
+		}
+	}
+
+	static void addShape(const FlatShape &shape, const PathConverter &converter, PolygonSet &out)
+	{
+		size_t n = shape.x.size();
+		if (shape.kind == BOUNDARY)
+		{
+			if (n > 1 && shape.x[0] == shape.x[n - 1] && shape.y[0] == shape.y[n - 1])
+				n--;
+			out.add(shape.x.data(), shape.y.data(), n);
+		}
+		else if (shape.kind == PATH)
+		{
+			converter.convert(shape.x.data(), shape.y.data(), n, shape.width, shape.path_type,
+				shape.begin_extn, shape.end_extn, out);
+		}
+	}
+
+	LayoutDiff::LayoutDiff(const DiffCallback &callback)
+	{
+		Callback = callback;
+		Threads = 0;
+		Tile_size = 100000;
+	}
+
+	void LayoutDiff::setThreads(int threads)
+	{
+		Threads = threads;
+	}
+
+	void LayoutDiff::setTileSize(int size)
+	{
+		Tile_size = std::max(size, 1);
+	}
+
+	void LayoutDiff::compare(Structure *a, Structure *b, std::vector<DiffLayer> &layers) const
+	{
+		DiffPairing pairing;
+		pairing.pair(a, b, Transform());
+		if (pairing.Changed.empty())
+			return;
+
+		Box bounds;
+		for (const Box &box : pairing.Changed)
+			bounds.add(box);
+		std::unordered_set<Structure*> seen;
+		if (a != nullptr)
+			prepare(a, seen);
+		if (b != nullptr)
+			prepare(b, seen);
+
+		// The tiles meeting a change, each with the box of its changes.
+		long long size = Tile_size;
+		long long nx = ((long long)bounds.x_max - bounds.x_min) / size + 1;
+		auto tileBox = [&](long long id)
+		{
+			long long x_min = bounds.x_min + id % nx * size, y_min = bounds.y_min + id / nx * size;
+			return Box((int)x_min, (int)y_min, (int)std::min(x_min + size, (long long)bounds.x_max),
+				(int)std::min(y_min + size, (long long)bounds.y_max));
+		};
+		std::map<long long, Box> dirty;
+		for (const Box &box : pairing.Changed)
+		{
+			// A box ending on a tile border only touches the next tile.
+			long long x0 = ((long long)box.x_min - bounds.x_min) / size;
+			long long x1 = std::max(x0, ((long long)box.x_max - bounds.x_min - 1) / size);
+			long long y0 = ((long long)box.y_min - bounds.y_min) / size;
+			long long y1 = std::max(y0, ((long long)box.y_max - bounds.y_min - 1) / size);
+			for (long long ty = y0; ty <= y1; ty++)
+			{
+				for (long long tx = x0; tx <= x1; tx++)
+				{
+					Box tile = tileBox(ty * nx + tx);
+					dirty[ty * nx + tx].add(Box(std::max(box.x_min, tile.x_min), std::max(box.y_min, tile.y_min),
+						std::min(box.x_max, tile.x_max), std::min(box.y_max, tile.y_max)));
+				}
+			}
+		}
+		std::vector<std::pair<long long, Box> > work(dirty.begin(), dirty.end());
+		dirty.clear();
+
+		std::mutex lock;
+		std::map<std::pair<short, short>, DiffLayer> found;
+		parallelFor(work.size(), Threads, [&](size_t t)
+		{
+			Box tile = tileBox(work[t].first);
+			const Box &changed = work[t].second;
+
+			// Both sides of each layer. The shapes which did not change are
+			// taken as well, since they may cover a change.
+			std::map<std::pair<short, short>, std::vector<PolygonSet> > shapes;
+			PathConverter converter;
+			int side = 0;
+			Flattener flattener([&](const FlatShape &shape)
+			{
+				if (shape.kind == TEXT)
+					return;
+				std::vector<PolygonSet> &layer = shapes[std::make_pair(shape.layer, shape.data_type)];
+				layer.resize(2);
+				addShape(shape, converter, layer[side]);
+			});
+			flattener.setWindow(changed);
+			flattener.run(a);
+			side = 1;
+			flattener.run(b);
+
+			BooleanEngine engine;
+			PolygonSet window;
+			int wx[4] = { changed.x_min, changed.x_max, changed.x_max, changed.x_min };
+			int wy[4] = { changed.y_min, changed.y_min, changed.y_max, changed.y_max };
+			window.add(wx, wy, 4);
+			for (auto &layer : shapes)
+			{
+				PolygonSet xor_shapes;
+				engine.run(layer.second[0], layer.second[1], BOOLEAN_XOR, xor_shapes);
+				if (xor_shapes.size() == 0)
+					continue;
+				DiffRegion region;
+				region.layer = layer.first.first;
+				region.data_type = layer.first.second;
+				region.tile = tile;
+				engine.run(xor_shapes, window, BOOLEAN_AND, region.polygons);
+				region.area = region.polygons.area();
+				if (region.polygons.size() == 0 || region.area <= 0)
+					continue;
+
+				std::lock_guard<std::mutex> guard(lock);
+				DiffLayer &summary = found[layer.first];
+				summary.layer = region.layer;
+				summary.data_type = region.data_type;
+				summary.area += region.area;
+				summary.polygons += region.polygons.size();
+				summary.tiles++;
+				if (Callback)
+					Callback(region);
+			}
+		});
+
+		for (auto &layer : found)
+		{
+			auto at = std::lower_bound(layers.begin(), layers.end(), layer.second, [](const DiffLayer &l, const DiffLayer &r)
+			{
+				return l.layer < r.layer || (l.layer == r.layer && l.data_type < r.data_type);
+			});
+			if (at != layers.end() && at->layer == layer.second.layer && at->data_type == layer.second.data_type)
+			{
+				at->area += layer.second.area;
+				at->polygons += layer.second.polygons;
+				at->tiles += layer.second.tiles;
+			}
+			else
+			{
+				layers.insert(at, layer.second);
+			}
+		}
+	}
+
+	std::vector<DiffLayer> LayoutDiff::run(Structure *a, Structure *b) const
+	{
+		std::vector<DiffLayer> layers;
+		compare(a, b, layers);
+		return layers;
+	}
+
+	std::vector<DiffLayer> LayoutDiff::run(Library &a, Library &b, const std::string &top) const
+	{
+		std::vector<DiffLayer> layers;
+		if (!top.empty())
+		{
+			compare(a.get(top), b.get(top), layers);
+			return layers;
+		}
+
+		Hierarchy tree_a(&a), tree_b(&b);
+		tree_a.computeHashes(Threads);
+		tree_b.computeHashes(Threads);
+		std::vector<StringId> names;
+		std::unordered_set<StringId> listed;
+		for (size_t cell : tree_a.tops())
+		{
+			if (listed.insert(tree_a.structure(cell)->nameId()).second)
+				names.push_back(tree_a.structure(cell)->nameId());
+		}
+		for (size_t cell : tree_b.tops())
+		{
+			if (listed.insert(tree_b.structure(cell)->nameId()).second)
+				names.push_back(tree_b.structure(cell)->nameId());
+		}
+		for (StringId name : names)
+			compare(a.find(name), b.find(name), layers);
+		return layers;
+	}
+}
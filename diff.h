@@ -0,0 +1,136 @@
+/*
+ * This file is part of GDSII.
+ *
+ * diff.h -- The header file which declare the geometric comparison of two
+ *           layouts.
+ *
+ * Copyright (c) 2015 Kangpeng Shao <billowen035@gmail.com>
+ *
+ * GDSII is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at you option) any later version.
+ *
+ * GDSII is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABLILTY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GDSII. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef GDS_DIFF_H
+#define GDS_DIFF_H
+
+#include <functional>
+#include <string>
+#include <vector>
+#include "geometry.h"
+#include "polygons.h"
+
+namespace GDS
+{
+	class Library;
+	class Structure;
+
+	/*!
+	 * \brief The difference of two layouts on one layer within one tile.
+	 */
+	struct DiffRegion
+	{
+		short       layer;
+		short       data_type;
+		Box         tile;
+		PolygonSet  polygons;       //< The XOR of both layouts, clipped to the tile.
+		double      area;
+	};
+
+	typedef std::function<void(const DiffRegion &region)> DiffCallback;
+
+	/*!
+	 * \brief The differences found on one layer.
+	 */
+	struct DiffLayer
+	{
+		short               layer;
+		short               data_type;
+		double              area;
+		size_t              polygons;
+		size_t              tiles;      //< Tiles with a difference on the layer.
+	};
+
+	/*!
+	 * \brief Geometric XOR of two layouts.
+	 *
+	 * First the hierarchies are compared from the top down. Elements which
+	 * are equal in both structures cancel out, references included, and
+	 * two equal structures end the comparison at once. Hashes only pick
+	 * the candidates; a StructureComparer confirms them. An SREF placed the
+	 * same way on both sides, to structures of the same name with different
+	 * contents, is compared below the placement. What is left over marks
+	 * where the layouts may differ.
+	 *
+	 * The plane is cut into square tiles, and only the tiles meeting what
+	 * is left over are compared, on several threads. Each tile flattens the
+	 * shapes of both layouts meeting the box of its changes through a
+	 * windowed Flattener, and XORs them layer by layer with the
+	 * BooleanEngine. A tile is dropped as soon as it is done, so the memory
+	 * used does not grow with the layout. Texts have no area and are not
+	 * compared.
+	 *
+	 * \code
+	 *  Library before, after;
+	 *  before.readParallel("before.gds");
+	 *  after.readParallel("after.gds");
+	 *  std::vector<DiffLayer> layers = LayoutDiff().run(before, after);
+	 * \endcode
+	 */
+	class LayoutDiff
+	{
+		DiffCallback    Callback;
+		int             Threads;
+		int             Tile_size;
+
+		void compare(Structure *a, Structure *b, std::vector<DiffLayer> &layers) const;
+
+	public:
+		/*!
+		 * \param [in] callback		Called with every region found, one call at
+		 *							a time but in no particular order. It may
+		 *							be empty.
+		 */
+		LayoutDiff(const DiffCallback &callback = DiffCallback());
+
+		/*!
+		 * \param [in] threads		Number of threads, 0 for defaultThreads(),
+		 *							which is the default.
+		 */
+		void setThreads(int threads);
+		/*!
+		 * \param [in] size			Side of the tiles in database units. The
+		 *							default is 100000.
+		 */
+		void setTileSize(int size);
+
+		/*!
+		 * \brief Compare two structures.
+		 *
+		 * Either may be nullptr, which counts as empty.
+		 *
+		 * \return	The layers with differences, ordered by layer and datatype.
+		 */
+		std::vector<DiffLayer> run(Structure *a, Structure *b) const;
+		/*!
+		 * \brief Compare two libraries.
+		 *
+		 * \param [in] top			Name of the structure to compare. If empty, the
+		 *							top cells of both libraries are compared by
+		 *							name; a top cell on one side only is compared
+		 *							with nothing.
+		 */
+		std::vector<DiffLayer> run(Library &a, Library &b, const std::string &top = "") const;
+	};
+}
+
+#endif
@@ -0,0 +1,169 @@
+/*
+ * This file is part of GDSII.
+ *
+ * difftest.cpp -- Tests of the geometric XOR of two layouts.
+ *
+ * Copyright (c) 2015 Kangpeng Shao <billowen035@gmail.com>
+ *
+ * GDSII is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at you option) any later version.
+ *
+ * GDSII is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABLILTY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GDSII. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "library.h"
+#include "structures.h"
+#include "diff.h"
+
+using namespace GDS;
+
+static int Failures = 0;
+
+static void check(bool ok, const std::string &what)
+{
+    if (!ok)
+    {
+        Failures++;
+        std::cout << "FAIL " << what << std::endl;
+    }
+}
+
+static Boundary* addBox(Structure *s, int layer, int x0, int y0, int x1, int y1)
+{
+    Boundary *b = new Boundary(s);
+    b->setLayer(layer);
+    b->setDataType(0);
+    std::vector<int> x = {x0, x1, x1, x0, x0}, y = {y0, y0, y1, y1, y0};
+    b->setXY(x, y);
+    s->add(b);
+    return b;
+}
+
+static void addSRef(Structure *s, const std::string &name, int x, int y, double angle, bool reflect)
+{
+    SRef *r = new SRef(s);
+    r->setStructName(name);
+    r->setXY(x, y);
+    r->setAngle(angle);
+    r->setStrans(reflect ? (short)REFLECTION : (short)0);
+    s->add(r);
+}
+
+static void addARef(Structure *s, const std::string &name, int rows, int cols, int x, int y, int dx, int dy, double angle)
+{
+    ARef *r = new ARef(s);
+    r->setStructName(name);
+    r->setRowCol(rows, cols);
+    std::vector<int> xs = {x, x + cols * dx, x}, ys = {y, y, y + rows * dy};
+    r->setXY(xs, ys);
+    r->setAngle(angle);
+    s->add(r);
+}
+
+/*
+ * 98 instances of leaf in 7 of mid, all apart from each other.
+ **/
+static void build(Library &lib)
+{
+    Structure *leaf = lib.add("leaf");
+    addBox(leaf, 1, 0, 0, 100, 50);
+    addBox(leaf, 2, 20, 10, 60, 300);
+
+    Structure *mid = lib.add("mid");
+    addSRef(mid, "leaf", 1000, 0, 90, false);
+    addSRef(mid, "leaf", -500, 700, 180, true);
+    addARef(mid, "leaf", 3, 4, 0, 2000, 400, 500, 270);
+    addBox(mid, 5, -1000, -1000, -900, -800);
+
+    Structure *top = lib.add("top");
+    addSRef(top, "mid", 0, 0, 0, false);
+    addSRef(top, "mid", 10000, 0, 90, false);
+    addSRef(top, "mid", 0, 10000, 0, true);
+    addARef(top, "mid", 2, 2, -20000, -20000, 6000, 7000, 0);
+}
+
+static const DiffLayer* find(const std::vector<DiffLayer> &layers, short layer)
+{
+    for (const DiffLayer &found : layers)
+    {
+        if (found.layer == layer && found.data_type == 0)
+            return &found;
+    }
+    return nullptr;
+}
+
+/*
+ * The layers found on one thread with the default tiles, on three threads
+ * with small tiles, and through the top cells of the libraries.
+ **/
+static void checkDiff(Library &a, Library &b, short layer, double area, const std::string &what)
+{
+    for (int config = 0; config < 3; config++)
+    {
+        LayoutDiff diff;
+        diff.setThreads(config == 1 ? 3 : 1);
+        if (config == 1)
+            diff.setTileSize(1000);
+        std::vector<DiffLayer> layers = config == 2 ? diff.run(a, b) : diff.run(a, b, "top");
+        std::string how = what + (config == 0 ? "" : config == 1 ? " in small tiles" : " of the top cells");
+        const DiffLayer *found = find(layers, layer);
+        check(layers.size() == 1 && found != nullptr, how + ": layers");
+        if (found != nullptr)
+            check(std::fabs(found->area - area) < 1e-6 && found->polygons > 0 && found->tiles > 0, how + ": area");
+    }
+}
+
+static void testDiff()
+{
+    Library a, b;
+    build(a);
+    build(b);
+    check(LayoutDiff().run(a, b, "top").empty(), "equal libraries");
+
+    // A new shape at the top.
+    Boundary *extra = addBox(b.get("top"), 1, -100000, -100000, -99000, -99500);
+    checkDiff(a, b, 1, 1000.0 * 500, "box at the top");
+    check(LayoutDiff().run(b, a, "top").size() == 1, "box at the top, swapped");
+    b.get("top")->set((int)b.get("top")->size() - 1, nullptr);
+    delete extra;
+    check(LayoutDiff().run(a, b, "top").empty(), "box removed again");
+
+    // A new shape in every instance of leaf.
+    Library c;
+    build(c);
+    addBox(c.get("leaf"), 7, 0, 0, 3, 3);
+    checkDiff(a, c, 7, 98 * 9.0, "box in the leaf");
+
+    // A shape of mid moved by 10 in x.
+    Library d;
+    build(d);
+    Structure *mid = d.get("mid");
+    Boundary *moved = static_cast<Boundary*>(mid->get((int)mid->size() - 1));
+    std::vector<int> x = {-990, -890, -890, -990, -990}, y = {-1000, -1000, -800, -800, -1000};
+    moved->setXY(x, y);
+    checkDiff(a, d, 5, 7 * 2 * 10.0 * 200, "box moved in mid");
+}
+
+int main()
+{
+    testDiff();
+    if (Failures > 0)
+    {
+        std::cout << Failures << " failures" << std::endl;
+        return 1;
+    }
+    std::cout << "all passed" << std::endl;
+    return 0;
+}
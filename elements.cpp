@@ -26,16 +26,81 @@
 namespace GDS
 {
 
+	// Every element is preceded by the arena it was allocated from, or
+	// nullptr. No element needs more than the alignment of a pointer.
+	static const size_t Header_size = sizeof(Arena*);
+
 	Element::Element(Structure* parent)
 	{
 		Tag = RECORD_UNKNOWN;
 		Parent = parent;
+		Storage = parent != nullptr ? parent->arena() : nullptr;
+		if (Storage != nullptr)
+			Storage->retain();
 	}
 
 	Element::Element(Record_type tag, Structure* parent)
 	{
 		Tag = tag;
 		Parent = parent;
+		Storage = parent != nullptr ? parent->arena() : nullptr;
+		if (Storage != nullptr)
+			Storage->retain();
+	}
+
+	Element::Element(const Element &other)
+	{
+		Tag = other.Tag;
+		Parent = other.Parent;
+		Storage = other.Storage;
+		if (Storage != nullptr)
+			Storage->retain();
+	}
+
+	Element& Element::operator=(const Element &other)
+	{
+		if (other.Storage != nullptr)
+			other.Storage->retain();
+		if (Storage != nullptr)
+			Storage->release();
+		Tag = other.Tag;
+		Parent = other.Parent;
+		Storage = other.Storage;
+		return *this;
+	}
+
+	void* Element::operator new(size_t size)
+	{
+		char *p = static_cast<char*>(::operator new(size + Header_size));
+		*reinterpret_cast<Arena**>(p) = nullptr;
+		return p + Header_size;
+	}
+
+	void* Element::operator new(size_t size, Arena *arena)
+	{
+		if (arena == nullptr)
+			return operator new(size);
+		char *p = static_cast<char*>(arena->allocate(size + Header_size, Header_size));
+		*reinterpret_cast<Arena**>(p) = arena;
+		arena->retain();
+		return p + Header_size;
+	}
+
+	void Element::operator delete(void *p)
+	{
+		if (p == nullptr)
+			return;
+		char *block = static_cast<char*>(p) - Header_size;
+		Arena *arena = *reinterpret_cast<Arena**>(block);
+		if (arena == nullptr)
+			::operator delete(block);
+		else
+			arena->release();
+	}
+
+	void Element::operator delete(void *p, Arena *)
+	{
+		operator delete(p);
 	}
 
 	Element::~Element()
@@ -51,6 +116,8 @@ namespace GDS
 				}
 			}
 		}
+		if (Storage != nullptr)
+			Storage->release();
 	}
 
 	std::string Element::type() const
@@ -76,17 +143,28 @@ namespace GDS
 		Parent = parent;
 	}
 
+	void Element::touch()
+	{
+		if (Parent != nullptr)
+			Parent->touch();
+	}
+
+	Arena* Element::storage() const
+	{
+		return Storage;
+	}
+
 	void Element::setTag(Record_type tag)
 	{
 		Tag = tag;
 	}
 
-	bool Element::read(std::ifstream &in)
+	bool Element::read(RecordReader &reader)
 	{
 		return true;
 	}
 
-	bool Element::write(std::ofstream &out)
+	bool Element::write(RecordWriter &writer)
 	{
 		return true;
 	}
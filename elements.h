@@ -25,31 +25,78 @@
 #include <vector>
 #include <string>
 #include <fstream>
+#include "arena.h"
 
 namespace GDS {
 	class Structure;
+	class RecordReader;
+	class RecordWriter;
+	class Boundary;
+	class Path;
+	class Text;
+	class SRef;
+	class ARef;
+
+	/*!
+	 * Coordinates of an element, kept in the arena of its structure.
+	 */
+	typedef std::vector<int, ArenaAllocator<int> > Coordinates;
 
 	class Element {
 		Record_type Tag;
 		Structure* Parent;
+		Arena*      Storage;        //< Arena of the coordinates, taken from the parent.
 
 	public:
 		Element(Structure* parent = nullptr);
 		Element(Record_type tag, Structure* parent = nullptr);
+		Element(const Element &other);
+		Element& operator=(const Element &other);
 		virtual ~Element();
 
+		/*!
+		 * \brief Allocate an element on the heap or in an arena.
+		 *
+		 * The memory of an element created with new(arena) goes back with
+		 * the arena, so delete stays valid for every element.
+		 */
+		static void* operator new(size_t size);
+		static void* operator new(size_t size, Arena *arena);
+		static void operator delete(void *p);
+		static void operator delete(void *p, Arena *arena);
+
 		Record_type tag() const;
 		std::string type() const;
 		Structure* parent();
 
 		void setParent(Structure* parent);
 
-		virtual bool read(std::ifstream &in);
-		virtual bool write(std::ofstream &out);
+		virtual bool read(RecordReader &reader);
+		virtual bool write(RecordWriter &writer);
 		virtual bool printASCII(std::ofstream &out);
 
 	protected:
 		void setTag(Record_type tag);
+		Arena* storage() const;
+		/*!
+		 * Tell the parent that the element has changed.
+		 */
+		void touch();
+	};
+
+	/*!
+	 * \brief Base of the visitors given to Structure::visit().
+	 *
+	 * A visitor hides the functions of the element types it cares about;
+	 * the others do nothing. The calls are resolved at compile time, so
+	 * they need not be virtual.
+	 */
+	struct ElementVisitor {
+		void boundary(Boundary &) {}
+		void path(Path &) {}
+		void text(Text &) {}
+		void sref(SRef &) {}
+		void aref(ARef &) {}
 	};
 
 }
@@ -0,0 +1,603 @@
+/*
+ * This file is part of GDSII.
+ *
+ * flatten.cpp -- The source file which defines the streaming flattener of
+ *                structure hierarchies.
+ *
+ * Copyright (c) 2015 Kangpeng Shao <billowen035@gmail.com>
+ *
+ * GDSII is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at you option) any later version.
+ *
+ * GDSII is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABLILTY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GDSII. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <unordered_set>
+#include "flatten.h"
+#include "structures.h"
+#include "parallel.h"
+
+namespace GDS
+{
+	static int roundCoordinate(double v)
+	{
+		return (int)std::floor(v + 0.5);
+	}
+
+	// Narrow the indices [min, max] to the real range [lo, hi].
+	static void narrow(double lo, double hi, int &min, int &max)
+	{
+		lo = std::ceil(lo);
+		hi = std::floor(hi);
+		if (lo > max || hi < min || lo > hi)
+		{
+			min = 0;
+			max = -1;
+			return;
+		}
+		if (lo > min)
+			min = (int)lo;
+		if (hi < max)
+			max = (int)hi;
+	}
+
+	// Narrow the indices [min, max] of a line of instances, offset by
+	// multiples of (x, y), to those whose offset can project into the
+	// given box of offsets.
+	static void lineRange(double lo_x, double hi_x, double lo_y, double hi_y, double x, double y,
+		int &min, int &max)
+	{
+		double length = x * x + y * y;
+		if (length == 0)
+			return;
+		double t_min = 0, t_max = 0;
+		for (int i = 0; i < 4; i++)
+		{
+			double t = ((i & 1 ? hi_x : lo_x) * x + (i & 2 ? hi_y : lo_y) * y) / length;
+			t_min = i == 0 ? t : std::min(t_min, t);
+			t_max = i == 0 ? t : std::max(t_max, t);
+		}
+		narrow(t_min, t_max, min, max);
+	}
+
+	// Instances of an array which may meet a window, as { col_min,
+	// col_max, row_min, row_max }. The range is found from the lattice
+	// of the array instead of by testing every instance; it may still
+	// hold instances which miss the window, which walk() drops.
+	static void arrayRange(ARef &node, Structure *child, const Transform &placement, const Box &window, int range[4])
+	{
+		range[0] = 0;
+		range[1] = node.col() - 1;
+		range[2] = 0;
+		range[3] = node.row() - 1;
+		Box first = (placement * node.transform()).apply(child->bbox());
+		if (first.empty() || range[1] < 0 || range[3] < 0)
+		{
+			range[1] = range[3] = -1;
+			return;
+		}
+
+		double col_x, col_y, row_x, row_y;
+		node.pitch(col_x, col_y, row_x, row_y);
+		placement.applyLinear(col_x, col_y, col_x, col_y);
+		placement.applyLinear(row_x, row_y, row_x, row_y);
+		// Offsets of an instance from the first one which let it meet the
+		// window, with a unit of slack for rounding.
+		double lo_x = (double)window.x_min - first.x_max - 1;
+		double hi_x = (double)window.x_max - first.x_min + 1;
+		double lo_y = (double)window.y_min - first.y_max - 1;
+		double hi_y = (double)window.y_max - first.y_min + 1;
+
+		double det = col_x * row_y - col_y * row_x;
+		if (det != 0)
+		{
+			// Lattice coordinates of the corners of the box of offsets.
+			double u_min = 0, u_max = 0, v_min = 0, v_max = 0;
+			for (int i = 0; i < 4; i++)
+			{
+				double x = i & 1 ? hi_x : lo_x;
+				double y = i & 2 ? hi_y : lo_y;
+				double u = (x * row_y - y * row_x) / det;
+				double v = (col_x * y - col_y * x) / det;
+				u_min = i == 0 ? u : std::min(u_min, u);
+				u_max = i == 0 ? u : std::max(u_max, u);
+				v_min = i == 0 ? v : std::min(v_min, v);
+				v_max = i == 0 ? v : std::max(v_max, v);
+			}
+			narrow(u_min, u_max, range[0], range[1]);
+			narrow(v_min, v_max, range[2], range[3]);
+		}
+		else if (range[1] == 0 || (col_x == 0 && col_y == 0))
+		{
+			// All instances lie on the line of the rows.
+			lineRange(lo_x, hi_x, lo_y, hi_y, row_x, row_y, range[2], range[3]);
+		}
+		else if (range[3] == 0 || (row_x == 0 && row_y == 0))
+		{
+			lineRange(lo_x, hi_x, lo_y, hi_y, col_x, col_y, range[0], range[1]);
+		}
+	}
+
+	// Emits the shapes of one structure and descends into its references.
+	struct FlattenVisitor : ElementVisitor
+	{
+		Flattener           &Owner;
+		const Transform     &Placement;
+		const Structure     *Source;
+
+		FlattenVisitor(Flattener &owner, const Transform &placement, const Structure *source)
+			: Owner(owner), Placement(placement), Source(source) {}
+
+		FlatShape& begin(Record_type kind, short layer, short data_type)
+		{
+			FlatShape &shape = Owner.Shape;
+			shape.kind = kind;
+			shape.layer = layer;
+			shape.data_type = data_type;
+			shape.width = 0;
+			shape.path_type = 0;
+			shape.begin_extn = 0;
+			shape.end_extn = 0;
+			shape.string = 0;
+			shape.transform = Placement;
+			shape.source = Source;
+			shape.depth = (int)Owner.Stack.size() - 1;
+			return shape;
+		}
+
+		void setPoints(FlatShape &shape, const int *x, const int *y, size_t count)
+		{
+			shape.x.resize(count);
+			shape.y.resize(count);
+			Placement.apply(x, y, count, shape.x.data(), shape.y.data());
+		}
+
+		bool inWindow(const Box &box) const
+		{
+			return !Owner.Windowed || Placement.apply(box).overlaps(Owner.Window);
+		}
+
+		void emit(const FlatShape &shape)
+		{
+			Owner.Count++;
+			Owner.Callback(shape);
+		}
+
+		void boundary(Boundary &node)
+		{
+			if (!inWindow(node.bbox()))
+				return;
+			FlatShape &shape = begin(BOUNDARY, node.layer(), node.dataType());
+			setPoints(shape, node.xData(), node.yData(), node.pointCount());
+			emit(shape);
+		}
+
+		void path(Path &node)
+		{
+			if (!inWindow(node.bbox()))
+				return;
+			FlatShape &shape = begin(PATH, node.layer(), node.dataType());
+			setPoints(shape, node.xData(), node.yData(), node.pointCount());
+			double scale = Placement.scale();
+			// A negative width is absolute and is not magnified.
+			shape.width = node.width() < 0 ? node.width() : roundCoordinate(node.width() * scale);
+			shape.path_type = (short)node.pathType();
+			int begin_extn, end_extn;
+			node.extension(begin_extn, end_extn);
+			shape.begin_extn = roundCoordinate(begin_extn * scale);
+			shape.end_extn = roundCoordinate(end_extn * scale);
+			emit(shape);
+		}
+
+		void text(Text &node)
+		{
+			if (!inWindow(node.bbox()))
+				return;
+			FlatShape &shape = begin(TEXT, node.layer(), node.textType());
+			int x, y;
+			node.xy(x, y);
+			setPoints(shape, &x, &y, 1);
+			shape.string = node.stringId();
+			emit(shape);
+		}
+
+		void sref(SRef &node)
+		{
+			Structure *child = node.target();
+			if (child != nullptr)
+				Owner.walk(child, Placement * node.transform());
+		}
+
+		void aref(ARef &node)
+		{
+			Structure *child = node.target();
+			if (child == nullptr)
+				return;
+			int range[4] = { 0, node.col() - 1, 0, node.row() - 1 };
+			if (Owner.Windowed)
+				arrayRange(node, child, Placement, Owner.Window, range);
+			for (int row = range[2]; row <= range[3]; row++)
+			{
+				for (int col = range[0]; col <= range[1]; col++)
+					Owner.walk(child, Placement * node.transform(col, row));
+			}
+		}
+	};
+
+	Flattener::Flattener(const FlatCallback &callback)
+	{
+		Callback = callback;
+		Max_depth = -1;
+		Count = 0;
+		Windowed = false;
+	}
+
+	void Flattener::setMaxDepth(int depth)
+	{
+		Max_depth = depth;
+	}
+
+	void Flattener::setWindow(const Box &window)
+	{
+		Window = window;
+		Windowed = true;
+	}
+
+	void Flattener::clearWindow()
+	{
+		Window = Box();
+		Windowed = false;
+	}
+
+	void Flattener::walk(Structure *structure, const Transform &transform, size_t first, size_t last)
+	{
+		if (Max_depth >= 0 && (int)Stack.size() > Max_depth)
+			return;
+		if (std::find(Stack.begin(), Stack.end(), structure) != Stack.end())
+			return;
+		if (Windowed && !transform.apply(structure->bbox()).overlaps(Window))
+			return;
+
+		Stack.push_back(structure);
+		FlattenVisitor visitor(*this, transform, structure);
+		if (Windowed && first == 0 && last == (size_t)-1 && transform.isRectilinear() && transform.scale() > 0)
+		{
+			// The window is taken back into the structure, with slack for
+			// the rounding of both directions; a rotated placement would
+			// need a larger window, so it scans the structure instead. All
+			// shapes are passed before any reference is entered, so one
+			// result buffer serves every level.
+			const SpatialIndex &index = structure->spatial();
+			Box local = transform.inverse().apply(Window);
+			if (!transform.isManhattan())
+			{
+				local.grow((int)std::min(std::ceil(1 / transform.scale()) + 1, 1e9));
+			}
+			Found.clear();
+			for (size_t i = 0; i < index.size(); i++)
+				index.get(i).query(local, Found);
+			for (Element *e : Found)
+				visitElement(visitor, e);
+			for (Element *e : index.references())
+				visitElement(visitor, e);
+		}
+		else
+		{
+			structure->visit(visitor, first, last);
+		}
+		Stack.pop_back();
+	}
+
+	unsigned long long Flattener::runRange(const std::vector<Structure*> &ancestors, Structure *structure,
+		const Transform &transform, size_t first, size_t last)
+	{
+		Count = 0;
+		Stack = ancestors;
+		walk(structure, transform, first, last);
+		return Count;
+	}
+
+	unsigned long long Flattener::run(Structure *top, const Transform &transform)
+	{
+		Count = 0;
+		Stack.clear();
+		if (top != nullptr)
+			walk(top, transform);
+		return Count;
+	}
+
+	// A piece of a parallel flattening: the elements [First, Last) of a
+	// structure, below the given ancestors.
+	struct FlattenTask
+	{
+		Structure*              Cell;
+		Transform               Placement;
+		size_t                  First;
+		size_t                  Last;
+		bool                    Whole;      // Covers the structure, so it may be split further.
+		std::vector<Structure*> Ancestors;
+	};
+
+	// Replace a whole-structure task by its runs of shapes and its
+	// placements, in the order the serial walk would meet them.
+	static bool splitTask(const FlattenTask &task, int max_depth, const Box *window, std::vector<FlattenTask> &out)
+	{
+		std::vector<Structure*> ancestors = task.Ancestors;
+		ancestors.push_back(task.Cell);
+		if (max_depth >= 0 && (int)ancestors.size() > max_depth)
+			return false;
+
+		size_t begin = out.size();
+		size_t n = task.Cell->size();
+		size_t run = 0;
+		bool split = false;
+		for (size_t i = 0; i < n; i++)
+		{
+			Element *e = task.Cell->get((int)i);
+			Structure *child = nullptr;
+			if (e->tag() == SREF)
+				child = static_cast<SRef*>(e)->target();
+			else if (e->tag() == AREF)
+				child = static_cast<ARef*>(e)->target();
+			if (child == nullptr || std::find(ancestors.begin(), ancestors.end(), child) != ancestors.end())
+				continue;
+
+			if (run < i)
+			{
+				FlattenTask shapes = { task.Cell, task.Placement, run, i, false, task.Ancestors };
+				out.push_back(shapes);
+			}
+			run = i + 1;
+			split = true;
+			if (e->tag() == SREF)
+			{
+				FlattenTask placement = { child, task.Placement * static_cast<SRef*>(e)->transform(),
+					0, (size_t)-1, true, ancestors };
+				if (window == nullptr || placement.Placement.apply(child->bbox()).overlaps(*window))
+					out.push_back(placement);
+				continue;
+			}
+			ARef *node = static_cast<ARef*>(e);
+			int range[4] = { 0, node->col() - 1, 0, node->row() - 1 };
+			if (window != nullptr)
+				arrayRange(*node, child, task.Placement, *window, range);
+			for (int row = range[2]; row <= range[3]; row++)
+			{
+				for (int col = range[0]; col <= range[1]; col++)
+				{
+					FlattenTask placement = { child, task.Placement * node->transform(col, row),
+						0, (size_t)-1, true, ancestors };
+					out.push_back(placement);
+				}
+			}
+		}
+		if (!split)
+		{
+			out.resize(begin);
+			return false;
+		}
+		if (run < n)
+		{
+			FlattenTask shapes = { task.Cell, task.Placement, run, n, false, task.Ancestors };
+			out.push_back(shapes);
+		}
+		return true;
+	}
+
+	// Shapes of one task, kept until the earlier tasks are passed on. The
+	// vertices of all shapes share two pools, and runs of shapes from one
+	// placement share its transform.
+	struct FlatBuffer
+	{
+		struct Header
+		{
+			Record_type         Kind;
+			short               Layer;
+			short               Data_type;
+			int                 Width;
+			short               Path_type;
+			int                 Begin_extn;
+			int                 End_extn;
+			StringId            String;
+			unsigned            Placement;  // Position in Placements.
+			int                 Depth;
+			size_t              End;        // End of the vertices in the pools.
+		};
+
+		struct Placement
+		{
+			Transform           Placed;
+			const Structure*    Source;
+		};
+
+		std::vector<Header>     Shapes;
+		std::vector<Placement>  Placements;
+		std::vector<int>        X, Y;
+
+		void add(const FlatShape &shape)
+		{
+			X.insert(X.end(), shape.x.begin(), shape.x.end());
+			Y.insert(Y.end(), shape.y.begin(), shape.y.end());
+			if (Placements.empty() || Placements.back().Source != shape.source
+				|| std::memcmp(&Placements.back().Placed, &shape.transform, sizeof(Transform)) != 0)
+			{
+				Placement placement = { shape.transform, shape.source };
+				Placements.push_back(placement);
+			}
+			Header header = { shape.kind, shape.layer, shape.data_type, shape.width, shape.path_type,
+				shape.begin_extn, shape.end_extn, shape.string, (unsigned)(Placements.size() - 1),
+				shape.depth, X.size() };
+			Shapes.push_back(header);
+		}
+
+		void get(size_t index, FlatShape &shape) const
+		{
+			const Header &header = Shapes[index];
+			shape.kind = header.Kind;
+			shape.layer = header.Layer;
+			shape.data_type = header.Data_type;
+			shape.width = header.Width;
+			shape.path_type = header.Path_type;
+			shape.begin_extn = header.Begin_extn;
+			shape.end_extn = header.End_extn;
+			shape.string = header.String;
+			shape.transform = Placements[header.Placement].Placed;
+			shape.source = Placements[header.Placement].Source;
+			shape.depth = header.Depth;
+			size_t begin = index == 0 ? 0 : Shapes[index - 1].End;
+			shape.x.assign(X.begin() + begin, X.begin() + header.End);
+			shape.y.assign(Y.begin() + begin, Y.begin() + header.End);
+		}
+
+		void swap(FlatBuffer &other)
+		{
+			Shapes.swap(other.Shapes);
+			Placements.swap(other.Placements);
+			X.swap(other.X);
+			Y.swap(other.Y);
+		}
+	};
+
+	// Load every structure below the top, so the threads only read. A
+	// windowed walk also needs the boxes and spatial indices.
+	static void loadAll(Structure *top, bool windowed)
+	{
+		std::unordered_set<Structure*> seen;
+		std::vector<Structure*> pending(1, top);
+		seen.insert(top);
+		while (!pending.empty())
+		{
+			Structure *cell = pending.back();
+			pending.pop_back();
+			if (windowed)
+				cell->spatial();
+			for (Structure *child : cell->children())
+			{
+				if (seen.insert(child).second)
+					pending.push_back(child);
+			}
+		}
+		if (windowed)
+			top->bbox();
+	}
+
+	unsigned long long Flattener::runParallel(Structure *top, int threads, bool deterministic, const Transform &transform)
+	{
+		if (top == nullptr)
+			return 0;
+		if (threads <= 0)
+			threads = defaultThreads();
+		loadAll(top, Windowed);
+
+		const size_t target = (size_t)threads * 64;
+		FlattenTask root = { top, transform, 0, (size_t)-1, true, std::vector<Structure*>() };
+		std::vector<FlattenTask> tasks(1, root);
+		bool split = true;
+		while (split && tasks.size() < target)
+		{
+			split = false;
+			std::vector<FlattenTask> next;
+			for (size_t i = 0; i < tasks.size(); i++)
+			{
+				if (tasks[i].Whole && next.size() + (tasks.size() - i) < target
+					&& splitTask(tasks[i], Max_depth, Windowed ? &Window : nullptr, next))
+				{
+					split = true;
+				}
+				else
+				{
+					next.push_back(tasks[i]);
+				}
+			}
+			tasks.swap(next);
+		}
+
+		std::atomic<unsigned long long> total(0);
+		if (!deterministic)
+		{
+			parallelFor(tasks.size(), threads, [&](size_t i)
+			{
+				Flattener worker(Callback);
+				worker.Max_depth = Max_depth;
+				worker.Window = Window;
+				worker.Windowed = Windowed;
+				const FlattenTask &task = tasks[i];
+				total += worker.runRange(task.Ancestors, task.Cell, task.Placement, task.First, task.Last);
+			});
+			return total;
+		}
+
+		// A task waits while it is more than Reorder_window tasks ahead of
+		// the next buffer to pass on, so a slow early task does not let the
+		// others pile up the whole output.
+		const size_t window = (size_t)threads * Reorder_window;
+		std::vector<FlatBuffer> buffers(tasks.size());
+		std::vector<bool> done(tasks.size(), false);
+		size_t emitted = 0;
+		bool failed = false;
+		std::mutex emit_mutex;
+		std::condition_variable emit_changed;
+		FlatShape shape;
+		parallelFor(tasks.size(), threads, [&](size_t i)
+		{
+			try
+			{
+				{
+					std::unique_lock<std::mutex> lock(emit_mutex);
+					emit_changed.wait(lock, [&]() { return failed || i < emitted + window; });
+					if (failed)
+						return;
+				}
+
+				FlatBuffer &buffer = buffers[i];
+				Flattener worker([&buffer](const FlatShape &shape) { buffer.add(shape); });
+				worker.Max_depth = Max_depth;
+				worker.Window = Window;
+				worker.Windowed = Windowed;
+				const FlattenTask &task = tasks[i];
+				total += worker.runRange(task.Ancestors, task.Cell, task.Placement, task.First, task.Last);
+
+				// Pass on every buffer whose predecessors are all out.
+				std::lock_guard<std::mutex> lock(emit_mutex);
+				done[i] = true;
+				size_t before = emitted;
+				while (emitted < tasks.size() && done[emitted])
+				{
+					FlatBuffer &ready = buffers[emitted];
+					for (size_t k = 0; k < ready.Shapes.size(); k++)
+					{
+						ready.get(k, shape);
+						Callback(shape);
+					}
+					FlatBuffer().swap(ready);
+					emitted++;
+				}
+				if (emitted != before)
+					emit_changed.notify_all();
+			}
+			catch (...)
+			{
+				// The waiting tasks would never be let through.
+				std::lock_guard<std::mutex> lock(emit_mutex);
+				failed = true;
+				emit_changed.notify_all();
+				throw;
+			}
+		});
+		return total;
+	}
+}
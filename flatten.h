@@ -0,0 +1,166 @@
+/*
+ * This file is part of GDSII.
+ *
+ * flatten.h -- The header file which declare the streaming flattener of
+ *              structure hierarchies.
+ *
+ * Copyright (c) 2015 Kangpeng Shao <billowen035@gmail.com>
+ *
+ * GDSII is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at you option) any later version.
+ *
+ * GDSII is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABLILTY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GDSII. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef GDS_FLATTEN_H
+#define GDS_FLATTEN_H
+
+#include <functional>
+#include <vector>
+#include "tags.h"
+#include "geometry.h"
+#include "stringtable.h"
+
+namespace GDS
+{
+	class Element;
+	class Structure;
+
+	/*!
+	 * \brief One shape of a flattened hierarchy, in top cell coordinates.
+	 */
+	struct FlatShape
+	{
+		Record_type         kind;           //< BOUNDARY, PATH or TEXT.
+		short               layer;
+		short               data_type;      //< DATATYPE, or TEXTTYPE of a text.
+		std::vector<int>    x, y;           //< Vertices, or the origin of a text.
+		int                 width;          //< Path width, magnified unless absolute.
+		short               path_type;
+		int                 begin_extn;     //< Path type 4 extensions, magnified.
+		int                 end_extn;
+		StringId            string;         //< Text string.
+		Transform           transform;      //< From the source structure to the top.
+		const Structure*    source;         //< Structure which holds the element.
+		int                 depth;          //< 0 for the top structure.
+	};
+
+	typedef std::function<void(const FlatShape &shape)> FlatCallback;
+
+	/*!
+	 * \brief Walk a hierarchy and hand every shape to a callback.
+	 *
+	 * The shapes are transformed through all SREF and AREF placements on
+	 * the way down, and passed one at a time; nothing is kept after the
+	 * callback returns, so the flattened data never has to fit in memory.
+	 *
+	 * With a window, only the shapes whose box meets the window are
+	 * passed, and the walk never enters a placement whose cached bounding
+	 * box misses it. Array instances are narrowed to the rows and columns
+	 * which can meet the window, and the shapes of each reached structure
+	 * come from its spatial index. A region of a huge layout costs about
+	 * as much as the shapes in it.
+	 *
+	 * \code
+	 *  Flattener flattener([&](const FlatShape &shape) { out.add(shape); });
+	 *  flattener.run(top);
+	 * \endcode
+	 */
+	class Flattener
+	{
+		static const int            Reorder_window = 4;     //< Tasks per thread a deterministic run may hold.
+
+		FlatCallback                Callback;
+		int                         Max_depth;
+		std::vector<Structure*>     Stack;      //< Structures being walked.
+		FlatShape                   Shape;      //< Reused for every callback.
+		unsigned long long          Count;
+		Box                         Window;
+		bool                        Windowed;
+		std::vector<Element*>       Found;      //< Reused for spatial queries.
+
+		friend struct FlattenVisitor;
+		void walk(Structure *structure, const Transform &transform, size_t first = 0, size_t last = (size_t)-1);
+		unsigned long long runRange(const std::vector<Structure*> &ancestors, Structure *structure,
+			const Transform &transform, size_t first, size_t last);
+
+	public:
+		Flattener(const FlatCallback &callback);
+
+		/*!
+		 * \brief Stop descending below a depth.
+		 *
+		 * \param [in] depth		Deepest level to emit, 0 for the top structure
+		 *							only. A negative depth has no limit, which is
+		 *							the default.
+		 */
+		void setMaxDepth(int depth);
+		/*!
+		 * \brief Pass only the shapes whose box meets a window.
+		 *
+		 * Boxes touching the window on its border count. The box of a shape
+		 * is its box in its own structure, placed in top coordinates; paths
+		 * include their width and extensions, texts only their origin. In
+		 * run(), the shapes of each structure come layer by layer instead of
+		 * in the order of the structure.
+		 *
+		 * \param [in] window		In the coordinates of the top structure.
+		 */
+		void setWindow(const Box &window);
+		void clearWindow();
+
+		/*!
+		 * \brief Flatten a structure.
+		 *
+		 * Every reached structure is loaded. References to missing structures,
+		 * and references back into a structure being walked, are skipped.
+		 *
+		 * \param [in] top			The structure to flatten.
+		 * \param [in] transform	Placement of the top structure.
+		 *
+		 * \return	The number of shapes passed to the callback.
+		 */
+		unsigned long long run(Structure *top, const Transform &transform = Transform());
+		/*!
+		 * \brief Flatten a structure on several threads.
+		 *
+		 * The hierarchy below the top is cut into many more tasks than
+		 * threads: runs of shapes, single references and single AREF
+		 * instances, split level by level. The threads take tasks from a
+		 * shared queue until it is empty, so large and small subtrees
+		 * balance out.
+		 *
+		 * Without determinism, the callback is called concurrently from all
+		 * threads; currentWorker() tells them apart, so they can fill
+		 * per-thread buffers. With determinism, each task fills a buffer of
+		 * its own, and the buffers are passed to the callback one call at a
+		 * time in the order of run(), as soon as all earlier tasks are done.
+		 * A task does not start more than 4 * threads tasks ahead of the
+		 * first one not passed on, so the buffers held at a time stay a few
+		 * tasks deep instead of growing with the output.
+		 *
+		 * Every reached structure is loaded before the threads start, and
+		 * with a window also its bounding box and spatial index. The order
+		 * of a windowed run() is not kept.
+		 *
+		 * \param [in] top				The structure to flatten.
+		 * \param [in] threads			Number of threads, 0 for defaultThreads().
+		 * \param [in] deterministic	Keep the order of run().
+		 * \param [in] transform		Placement of the top structure.
+		 *
+		 * \return	The number of shapes passed to the callback.
+		 */
+		unsigned long long runParallel(Structure *top, int threads = 0, bool deterministic = false,
+			const Transform &transform = Transform());
+	};
+}
+
+#endif
@@ -0,0 +1,272 @@
+/*
+ * This file is part of GDSII.
+ *
+ * flattentest.cpp -- Tests of the hierarchy of a library and of its
+ *                    flattening.
+ *
+ * Copyright (c) 2015 Kangpeng Shao <billowen035@gmail.com>
+ *
+ * GDSII is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at you option) any later version.
+ *
+ * GDSII is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABLILTY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GDSII. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#include <algorithm>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "library.h"
+#include "structures.h"
+#include "hierarchy.h"
+#include "flatten.h"
+
+using namespace GDS;
+
+static int Failures = 0;
+
+static void check(bool ok, const std::string &what)
+{
+    if (!ok)
+    {
+        Failures++;
+        std::cout << "FAIL " << what << std::endl;
+    }
+}
+
+static unsigned int Seed = 11;
+
+static int random(int n)
+{
+    Seed = Seed * 1103515245 + 12345;
+    return (int)((Seed >> 16) % (unsigned int)n);
+}
+
+static void addBox(Structure *s, int layer, int x0, int y0, int x1, int y1)
+{
+    Boundary *b = new Boundary(s);
+    b->setLayer(layer);
+    std::vector<int> x = {x0, x1, x1, x0, x0}, y = {y0, y0, y1, y1, y0};
+    b->setXY(x, y);
+    s->add(b);
+}
+
+static void addSRef(Structure *s, const std::string &name, int x, int y, double angle, bool reflect)
+{
+    SRef *r = new SRef(s);
+    r->setStructName(name);
+    r->setXY(x, y);
+    r->setAngle(angle);
+    r->setStrans(reflect ? (short)REFLECTION : (short)0);
+    s->add(r);
+}
+
+static void addARef(Structure *s, const std::string &name, int rows, int cols, int x, int y, int dx, int dy, double angle)
+{
+    ARef *r = new ARef(s);
+    r->setStructName(name);
+    r->setRowCol(rows, cols);
+    std::vector<int> xs = {x, x + cols * dx, x}, ys = {y, y, y + rows * dy};
+    r->setXY(xs, ys);
+    r->setAngle(angle);
+    s->add(r);
+}
+
+/*
+ * leaf: 3 boxes, a path and a text.
+ * mid:  2 SREFs and a 3 x 4 AREF of leaf, and a box.
+ * top:  3 SREFs and a 2 x 2 AREF of mid, and a text.
+ **/
+static void build(Library &lib)
+{
+    Structure *leaf = lib.add("leaf");
+    addBox(leaf, 1, 0, 0, 100, 50);
+    addBox(leaf, 2, 20, 10, 60, 300);
+    addBox(leaf, 1, -40, -30, 0, 0);
+    Path *p = new Path(leaf);
+    p->setLayer(3);
+    p->setWidth(20);
+    p->setPathType(2);
+    std::vector<int> px = {0, 0, 150}, py = {0, 120, 120};
+    p->setXY(px, py);
+    leaf->add(p);
+    Text *t = new Text(leaf);
+    t->setLayer(4);
+    t->setXY(77, 33);
+    t->setString("leaf");
+    leaf->add(t);
+
+    Structure *mid = lib.add("mid");
+    addSRef(mid, "leaf", 1000, 0, 90, false);
+    addSRef(mid, "leaf", -500, 700, 180, true);
+    addARef(mid, "leaf", 3, 4, 0, 2000, 400, 500, 270);
+    addBox(mid, 5, -1000, -1000, -900, -800);
+
+    Structure *top = lib.add("top");
+    addSRef(top, "mid", 0, 0, 0, false);
+    addSRef(top, "mid", 10000, 0, 90, false);
+    addSRef(top, "mid", 0, 10000, 0, true);
+    addARef(top, "mid", 2, 2, -20000, -20000, 6000, 7000, 0);
+    Text *label = new Text(top);
+    label->setLayer(6);
+    label->setXY(-5, -5);
+    label->setString("top");
+    top->add(label);
+}
+
+static void testHierarchy(Library &lib)
+{
+    Hierarchy hierarchy(&lib);
+    size_t leaf = hierarchy.index(lib.get("leaf"));
+    size_t mid = hierarchy.index(lib.get("mid"));
+    size_t top = hierarchy.index(lib.get("top"));
+    check(hierarchy.size() == 3 && hierarchy.isAcyclic(), "hierarchy size");
+    check(hierarchy.tops().size() == 1 && hierarchy.tops()[0] == top, "top cells");
+    check(hierarchy.instances(top) == 1, "top instances");
+    check(hierarchy.instances(mid) == 7, "mid instances");
+    check(hierarchy.instances(leaf) == 98, "leaf instances");
+    check(hierarchy.children(top).size() == 1 && hierarchy.children(top)[0].count == 7, "top edges");
+    check(hierarchy.children(mid).size() == 1 && hierarchy.children(mid)[0].count == 14, "mid edges");
+    check(hierarchy.parents(leaf).size() == 1 && hierarchy.parents(leaf)[0].cell == mid, "leaf parents");
+    const std::vector<size_t> &order = hierarchy.order();
+    check(order.size() == 3 && order[0] == leaf && order[1] == mid && order[2] == top, "order");
+}
+
+/*
+ * The box the window of a Flattener is checked against.
+ **/
+static Box shapeBox(const FlatShape &shape)
+{
+    Box box;
+    for (size_t i = 0; i < shape.x.size(); i++)
+        box.add(shape.x[i], shape.y[i]);
+    // Square ends: every straight Manhattan path grows by half its width.
+    if (shape.kind == PATH)
+        box.grow(shape.width / 2);
+    return box;
+}
+
+static std::vector<FlatShape> flatten(Structure *top, const Box *window)
+{
+    std::vector<FlatShape> shapes;
+    Flattener flattener([&](const FlatShape &shape) { shapes.push_back(shape); });
+    if (window != nullptr)
+        flattener.setWindow(*window);
+    unsigned long long count = flattener.run(top);
+    check(count == shapes.size(), "count returned by run");
+    return shapes;
+}
+
+typedef std::vector<int> ShapeKey;
+
+static ShapeKey key(const FlatShape &shape)
+{
+    ShapeKey k = {shape.kind, shape.layer, shape.depth};
+    k.insert(k.end(), shape.x.begin(), shape.x.end());
+    k.insert(k.end(), shape.y.begin(), shape.y.end());
+    return k;
+}
+
+static std::vector<ShapeKey> keys(const std::vector<FlatShape> &shapes, bool sorted)
+{
+    std::vector<ShapeKey> result;
+    for (const FlatShape &shape : shapes)
+        result.push_back(key(shape));
+    if (sorted)
+        std::sort(result.begin(), result.end());
+    return result;
+}
+
+static void testFlatten(Library &lib)
+{
+    Structure *top = lib.get("top");
+    std::vector<FlatShape> shapes = flatten(top, nullptr);
+    check(shapes.size() == 98 * 5 + 7 + 1, "flat shapes");
+    size_t boxes = 0;
+    Box all;
+    for (const FlatShape &shape : shapes)
+    {
+        if (shape.kind == BOUNDARY && shape.layer == 5)
+            boxes++;
+        all.add(shapeBox(shape));
+    }
+    check(boxes == 7, "flat boxes of mid");
+    check(all == top->bbox(), "flat shapes against bbox()");
+
+    Flattener limited([](const FlatShape &) {});
+    limited.setMaxDepth(1);
+    check(limited.run(top) == 7 + 1, "flat shapes down to depth 1");
+
+    // Windows near the shapes, from points to most of the top, against
+    // the full run.
+    Box bbox = top->bbox();
+    for (int round = 0; round < 300; round++)
+    {
+        Box near = shapeBox(shapes[random((int)shapes.size())]);
+        int size = round % 10 == 0 ? 20000 : 500;
+        int x0 = near.x_min - size / 2 + random(size), y0 = near.y_min - size / 2 + random(size);
+        Box window(x0, y0, x0 + random(size), y0 + random(size));
+        std::vector<ShapeKey> expected;
+        for (const FlatShape &shape : shapes)
+        {
+            if (shapeBox(shape).overlaps(window))
+                expected.push_back(key(shape));
+        }
+        std::sort(expected.begin(), expected.end());
+        check(keys(flatten(top, &window), true) == expected, "window " + std::to_string(round));
+    }
+    check(flatten(top, &bbox).size() == shapes.size(), "window of the bbox");
+    Box outside(bbox.x_max + 1, bbox.y_max + 1, bbox.x_max + 100, bbox.y_max + 100);
+    check(flatten(top, &outside).empty(), "window outside the bbox");
+}
+
+static void testParallel(Library &lib)
+{
+    Structure *top = lib.get("top");
+    std::vector<ShapeKey> expected = keys(flatten(top, nullptr), false);
+    std::vector<ShapeKey> sorted = expected;
+    std::sort(sorted.begin(), sorted.end());
+    for (int threads = 1; threads <= 4; threads++)
+    {
+        std::vector<ShapeKey> ordered;
+        Flattener deterministic([&](const FlatShape &shape) { ordered.push_back(key(shape)); });
+        deterministic.runParallel(top, threads, true);
+        check(ordered == expected, "deterministic order with " + std::to_string(threads) + " threads");
+
+        std::vector<ShapeKey> any;
+        std::mutex mutex;
+        Flattener concurrent([&](const FlatShape &shape)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            any.push_back(key(shape));
+        });
+        concurrent.runParallel(top, threads, false);
+        std::sort(any.begin(), any.end());
+        check(any == sorted, "shapes with " + std::to_string(threads) + " threads");
+    }
+}
+
+int main()
+{
+    Library lib;
+    build(lib);
+    testHierarchy(lib);
+    testFlatten(lib);
+    testParallel(lib);
+    if (Failures > 0)
+    {
+        std::cout << Failures << " failures" << std::endl;
+        return 1;
+    }
+    std::cout << "all passed" << std::endl;
+    return 0;
+}
@@ -44,39 +44,11 @@ namespace GDS
 			Structure* structure_node = lib->get(i);
 			if (structure_node == nullptr)
 				continue;
-			for (size_t j = 0; j < structure_node->size(); j++)
+			const LayerStore &layers = structure_node->layers();
+			for (size_t j = 0; j < layers.size(); j++)
 			{
-				Element* e = structure_node->get(j);
-				if (e == nullptr)
-					continue;
-				int layer = -1, dt = -1;
-				switch (e->tag())
-				{
-				case BOUNDARY:
-					if (Boundary* node = dynamic_cast<Boundary*>(e))
-					{
-						layer = node->layer();
-						dt = node->dataType();
-					}
-					break;
-				case PATH:
-					if (Path* node = dynamic_cast<Path*>(e))
-					{
-						layer = node->layer();
-						dt = node->dataType();
-					}
-					break;
-				case TEXT:
-					if (Text* node = dynamic_cast<Text*>(e))
-					{
-						layer = node->layer();
-						dt = node->textType();
-					}
-					break;
-				default:
-					break;
-				}
-
+				int layer = layers.get(j).layer();
+				int dt = layers.get(j).dataType();
 				if (layer >= 0 && dt >= 0)
 				{
 					if (!techfile->haveLayer(layer, dt))
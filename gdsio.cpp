@@ -21,7 +21,16 @@
  **/
 
 #include <sstream>
+#include <cstring>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
 #include "log.h"
+#include "exceptions.h"
 #include "gdsio.h"
 
 
@@ -98,16 +107,15 @@ std::string GDS::readString(std::ifstream &in, int size)
 #ifdef _DEBUG_LOG
     LogIO* log = LogIO::getInstance();
 #endif
-    std::string data;
+    std::string data(size, '\0');
+    if (size > 0)
+        in.read(&data[0], size);
+#ifdef _DEBUG_LOG
     for (int i = 0; i < size; i++)
     {
-        char c;
-        in.read(&c, 1);
-        data.push_back(c);
-#ifdef _DEBUG_LOG
-        log->write(byteToString(c));
-#endif
+        log->write(byteToString(data[i]));
     }
+#endif
     return data;
 }
 
@@ -155,78 +163,14 @@ double GDS::readDouble(std::ifstream &in)
     }
 #endif
 
-    short sign_flag = (buffer[0] & 0x80) ? -1 : 1;
-    short exponent = (buffer[0] & 0x7f) - 64;
-    long long mantissa = 0;
-    for (int i = 1; i < 8; i++)
-    {
-        mantissa = mantissa << 8;
-        //mantissa = mantissa | (0x00000000000000ff & buffer[i]);
-        mantissa = mantissa | buffer[i];
-    }
-    double data = mantissa;
-    for (int i = 0; i < 56; i++)
-    {
-        data /= 2;
-    }
-    if (exponent >= 0)
-    {
-        for (int j = 0; j < exponent; j++)
-        {
-            data = data * 16;
-        }
-    }
-    else
-    {
-        for (int j = 0; j < -exponent; j++)
-        {
-            data = data / 16;
-        }
-    }
-    return data * sign_flag;
+    return bytesToDouble(buffer);
 }
 
 void GDS::writeDouble(std::ofstream &out, double data)
 {
     unsigned char buffer[8];
-    if (data == 0)
-    {
-        for (int i = 0; i < 8; i++)
-        {
-            buffer[i] = 0;
-        }
-        out.write((char*)buffer, 8);
-    }
-    else
-    {
-        double mantissa = data >= 0 ? data : -data;
-        short exponent = 0;
-        while (mantissa >= 1 || mantissa < (1.0 / 16))
-        {
-            if (mantissa >= 1)
-            {
-                mantissa /= 16;
-                exponent ++;
-            }
-            else
-            {
-                mantissa *= 16;
-                exponent --;
-            }
-        }
-        exponent += 64;
-        buffer[0] = exponent;
-        if (data < 0)
-            buffer[0] = buffer[0] | 0x80;
-        for (int j = 1; j < 8; j++)
-        {
-            mantissa *= 256;
-            buffer[j] = mantissa;
-            mantissa = mantissa - int(mantissa);
-
-        }
-        out.write((char*)buffer, 8);
-    }
+    doubleToBytes(data, buffer);
+    out.write((char*)buffer, 8);
 
 #ifdef _DEBUG_LOG
     LogIO* log = LogIO::getInstance();
@@ -263,3 +207,490 @@ std::string GDS::byteToString(Byte data)
     ss << std::hex << data;
     return ss.str();
 }
+
+short GDS::bytesToShort(const Byte *data)
+{
+    return (short)(data[0] << 8 | data[1]);
+}
+
+int GDS::bytesToInteger(const Byte *data)
+{
+    return (int)((unsigned int)data[0] << 24
+            | (unsigned int)data[1] << 16
+            | (unsigned int)data[2] << 8
+            | (unsigned int)data[3]);
+}
+
+/*
+ * Position of the highest set bit of a non-zero value.
+ **/
+static int highestBit(unsigned long long value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return 63 - __builtin_clzll(value);
+#else
+    int pos = 0;
+    for (int step = 32; step > 0; step >>= 1)
+    {
+        if (value >> step)
+        {
+            value >>= step;
+            pos += step;
+        }
+    }
+    return pos;
+#endif
+}
+
+/*
+ * An 8-byte GDSII real is a sign bit, a 7-bit base-16 exponent in excess-64
+ * notation and a 56-bit fraction:
+ *
+ *     value = fraction / 2^56 * 16^(exponent - 64)
+ *
+ * The whole exponent range of GDSII reals lies within the normal range of
+ * IEEE-754 doubles, so both directions reduce to a shift of the mantissa
+ * and an adjustment of the exponent.
+ **/
+double GDS::bytesToDouble(const Byte *data)
+{
+    unsigned long long mantissa = 0;
+    for (int i = 1; i < 8; i++)
+    {
+        mantissa = (mantissa << 8) | data[i];
+    }
+    unsigned long long sign = (unsigned long long)(data[0] & 0x80) << 56;
+    if (mantissa == 0)
+    {
+        double value;
+        memcpy(&value, &sign, 8);
+        return value;
+    }
+
+    // Normalize to the 53-bit significand of a double, rounding to nearest even.
+    int top = highestBit(mantissa);
+    int exponent = top - 56 + 4 * ((data[0] & 0x7f) - 64);
+    if (top > 52)
+    {
+        int shift = top - 52;
+        unsigned long long rest = mantissa & ((1ULL << shift) - 1);
+        unsigned long long half = 1ULL << (shift - 1);
+        mantissa >>= shift;
+        if (rest > half || (rest == half && (mantissa & 1)))
+        {
+            mantissa++;
+            if (mantissa >> 53)
+            {
+                mantissa >>= 1;
+                exponent++;
+            }
+        }
+    }
+    else
+    {
+        mantissa <<= 52 - top;
+    }
+
+    unsigned long long bits = sign
+            | (unsigned long long)(exponent + 1023) << 52
+            | (mantissa & ((1ULL << 52) - 1));
+    double value;
+    memcpy(&value, &bits, 8);
+    return value;
+}
+
+void GDS::doubleToBytes(double value, Byte *data)
+{
+    unsigned long long bits;
+    memcpy(&bits, &value, 8);
+    Byte sign = (bits >> 56) & 0x80;
+    int biased = (int)((bits >> 52) & 0x7ff);
+    unsigned long long mantissa = bits & ((1ULL << 52) - 1);
+
+    // Zeros and subnormals are far below the smallest GDSII real.
+    if (biased == 0)
+    {
+        memset(data, 0, 8);
+        data[0] = sign;
+        return;
+    }
+    // Infinities and NaNs saturate to the largest GDSII real.
+    if (biased == 0x7ff)
+    {
+        data[0] = sign | 0x7f;
+        memset(data + 1, 0xff, 7);
+        return;
+    }
+
+    // value = mantissa * 2^(exponent - 52) with the leading bit at 52.
+    mantissa |= 1ULL << 52;
+    int exponent = biased - 1023;
+    // Put the leading bit at 52..55 so that the binary exponent becomes a
+    // multiple of 4; the 53 significant bits always fit into 56 bits.
+    int shift = ((exponent + 260) % 4 + 4) % 4;
+    mantissa <<= shift;
+    int hex_exponent = (exponent - shift - 52 + 56) / 4 + 64;
+    if (hex_exponent > 127)
+    {
+        data[0] = sign | 0x7f;
+        memset(data + 1, 0xff, 7);
+        return;
+    }
+    if (hex_exponent < 0)
+    {
+        // Denormalize the fraction; GDSII allows leading zero digits.
+        int drop = -4 * hex_exponent;
+        mantissa = drop < 64 ? mantissa >> drop : 0;
+        hex_exponent = 0;
+    }
+
+    data[0] = sign | (Byte)hex_exponent;
+    for (int i = 7; i >= 1; i--)
+    {
+        data[i] = mantissa & 0xff;
+        mantissa >>= 8;
+    }
+}
+
+void GDS::decodeXY(const Byte *data, int num, int *x, int *y)
+{
+    int i = 0;
+#if defined(__AVX2__)
+    // Byte-swap every integer and gather x0 x1 y0 y1 inside each lane,
+    // then put the x of both lanes in front of the y.
+    const __m256i swap = _mm256_setr_epi8(
+        3, 2, 1, 0, 11, 10, 9, 8, 7, 6, 5, 4, 15, 14, 13, 12,
+        3, 2, 1, 0, 11, 10, 9, 8, 7, 6, 5, 4, 15, 14, 13, 12);
+    for (; i + 4 <= num; i += 4)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(data + 8 * i));
+        v = _mm256_shuffle_epi8(v, swap);
+        v = _mm256_permute4x64_epi64(v, _MM_SHUFFLE(3, 1, 2, 0));
+        _mm_storeu_si128((__m128i*)(x + i), _mm256_castsi256_si128(v));
+        _mm_storeu_si128((__m128i*)(y + i), _mm256_extracti128_si256(v, 1));
+    }
+#elif defined(__SSSE3__)
+    const __m128i swap = _mm_setr_epi8(
+        3, 2, 1, 0, 11, 10, 9, 8, 7, 6, 5, 4, 15, 14, 13, 12);
+    for (; i + 4 <= num; i += 4)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i*)(data + 8 * i));
+        __m128i b = _mm_loadu_si128((const __m128i*)(data + 8 * i + 16));
+        a = _mm_shuffle_epi8(a, swap);
+        b = _mm_shuffle_epi8(b, swap);
+        _mm_storeu_si128((__m128i*)(x + i), _mm_unpacklo_epi64(a, b));
+        _mm_storeu_si128((__m128i*)(y + i), _mm_unpackhi_epi64(a, b));
+    }
+#elif defined(__SSE2__) || defined(_M_X64)
+    for (; i + 4 <= num; i += 4)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i*)(data + 8 * i));
+        __m128i b = _mm_loadu_si128((const __m128i*)(data + 8 * i + 16));
+        // Swap the bytes of every 16-bit word, then the words of every integer.
+        a = _mm_or_si128(_mm_slli_epi16(a, 8), _mm_srli_epi16(a, 8));
+        b = _mm_or_si128(_mm_slli_epi16(b, 8), _mm_srli_epi16(b, 8));
+        a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(a, 0xb1), 0xb1);
+        b = _mm_shufflehi_epi16(_mm_shufflelo_epi16(b, 0xb1), 0xb1);
+        a = _mm_shuffle_epi32(a, _MM_SHUFFLE(3, 1, 2, 0));
+        b = _mm_shuffle_epi32(b, _MM_SHUFFLE(3, 1, 2, 0));
+        _mm_storeu_si128((__m128i*)(x + i), _mm_unpacklo_epi64(a, b));
+        _mm_storeu_si128((__m128i*)(y + i), _mm_unpackhi_epi64(a, b));
+    }
+#endif
+    for (; i < num; i++)
+    {
+        x[i] = bytesToInteger(data + 8 * i);
+        y[i] = bytesToInteger(data + 8 * i + 4);
+    }
+}
+
+int GDS::Record::length() const
+{
+    return size - 4;
+}
+
+short GDS::Record::getShort(int index) const
+{
+    return bytesToShort(data + 2 * index);
+}
+
+int GDS::Record::getInteger(int index) const
+{
+    return bytesToInteger(data + 4 * index);
+}
+
+double GDS::Record::getDouble(int index) const
+{
+    return bytesToDouble(data + 8 * index);
+}
+
+std::string GDS::Record::getString() const
+{
+    int n = length();
+    while (n > 0 && data[n - 1] == '\0')
+        n--;
+    return std::string((const char*)data, n);
+}
+
+GDS::RecordReader::RecordReader(std::istream &in, size_t block_size)
+{
+    In = &in;
+    // One record is at most 65535 bytes and has to fit into the buffer.
+    if (block_size < 2 * 65536)
+        block_size = 2 * 65536;
+    Buffer.resize(block_size);
+    Data = &Buffer[0];
+    Begin = 0;
+    End = 0;
+    Buffer_offset = 0;
+    Record_offset = 0;
+    Current.size = 0;
+    Current.record_type = RECORD_UNKNOWN;
+    Current.data_type = DATA_UNKNOWN;
+    Current.data = nullptr;
+}
+
+GDS::RecordReader::RecordReader(const Byte *data, size_t size, long long offset)
+{
+    In = nullptr;
+    Data = data;
+    Begin = 0;
+    End = size;
+    Buffer_offset = offset;
+    Record_offset = offset;
+    Current.size = 0;
+    Current.record_type = RECORD_UNKNOWN;
+    Current.data_type = DATA_UNKNOWN;
+    Current.data = nullptr;
+}
+
+bool GDS::RecordReader::fill(size_t need)
+{
+    if (End - Begin >= need)
+        return true;
+    if (In == nullptr)
+        return false;
+
+    size_t remain = End - Begin;
+    if (remain > 0 && Begin > 0)
+        memmove(&Buffer[0], &Buffer[Begin], remain);
+    Buffer_offset += Begin;
+    Begin = 0;
+    End = remain;
+
+    while (End < need && In->good())
+    {
+        In->read((char*)&Buffer[End], Buffer.size() - End);
+        End += (size_t)In->gcount();
+    }
+    return End - Begin >= need;
+}
+
+bool GDS::RecordReader::next()
+{
+    if (!fill(4))
+    {
+        if (End != Begin)
+            throw FormatError("unexpected end of file inside a record header.");
+        return false;
+    }
+
+    const Byte *header = Data + Begin;
+    unsigned short size = (unsigned short)(header[0] << 8 | header[1]);
+    if (size < 4)
+    {
+        std::stringstream ss;
+        ss << "wrong record size (" << size << ") at offset " << Buffer_offset + Begin << ".";
+        throw FormatError(ss.str());
+    }
+    if (!fill(size))
+        throw FormatError("unexpected end of file inside a record.");
+
+    header = Data + Begin;
+    Current.size = size;
+    Current.record_type = header[2];
+    Current.data_type = header[3];
+    Current.data = header + 4;
+    Record_offset = Buffer_offset + Begin;
+    Begin += size;
+
+#ifdef _DEBUG_LOG
+    LogIO* log = LogIO::getInstance();
+    for (int i = 0; i < size; i++)
+    {
+        log->write(byteToString(header[i]));
+    }
+#endif
+    return true;
+}
+
+const GDS::Record& GDS::RecordReader::record() const
+{
+    return Current;
+}
+
+long long GDS::RecordReader::offset() const
+{
+    return Record_offset;
+}
+
+GDS::RecordWriter::RecordWriter(std::ostream &out, size_t block_size)
+{
+    Out = &out;
+    if (block_size < 2 * 65536)
+        block_size = 2 * 65536;
+    Buffer.resize(block_size);
+    Used = 0;
+}
+
+GDS::RecordWriter::~RecordWriter()
+{
+    flush();
+}
+
+void GDS::RecordWriter::flush()
+{
+    if (Used > 0)
+        Out->write((const char*)&Buffer[0], Used);
+    Used = 0;
+}
+
+void GDS::RecordWriter::writeRaw(const Byte *data, size_t size)
+{
+    if (Used + size > Buffer.size())
+        flush();
+    if (size > Buffer.size())
+    {
+        Out->write((const char*)data, size);
+        return;
+    }
+    memcpy(&Buffer[Used], data, size);
+    Used += size;
+}
+
+GDS::Byte* GDS::RecordWriter::begin(Byte record_type, Byte data_type, size_t length)
+{
+    // The size field of a record has 16 bits, the header included.
+    if (length > 65531)
+    {
+        std::stringstream ss;
+        ss << Record_name[record_type] << " record too long (" << length << " bytes).";
+        throw FormatError(ss.str());
+    }
+    size_t size = 4 + length;
+    if (Used + size > Buffer.size())
+        flush();
+    if (size > Buffer.size())
+        Buffer.resize(size);
+    Byte *p = &Buffer[Used];
+    Used += size;
+    p[0] = (size >> 8) & 0xff;
+    p[1] = size & 0xff;
+    p[2] = record_type;
+    p[3] = data_type;
+    return p + 4;
+}
+
+#ifdef _DEBUG_LOG
+static void logRecord(const GDS::Byte *payload)
+{
+    GDS::LogIO* log = GDS::LogIO::getInstance();
+    const GDS::Byte *record = payload - 4;
+    int size = record[0] << 8 | record[1];
+    for (int i = 0; i < size; i++)
+    {
+        log->write(GDS::byteToString(record[i]));
+    }
+}
+#endif
+
+void GDS::RecordWriter::writeRecord(Record_type type)
+{
+#ifdef _DEBUG_LOG
+    Byte *p = begin(type, NoData, 0);
+    logRecord(p);
+#else
+    begin(type, NoData, 0);
+#endif
+}
+
+void GDS::RecordWriter::writeShort(Record_type type, short data)
+{
+    writeShorts(type, &data, 1);
+}
+
+void GDS::RecordWriter::writeShorts(Record_type type, const short *data, int num)
+{
+    Byte *p = begin(type, Integer_2, 2 * num);
+    for (int i = 0; i < num; i++)
+    {
+        p[2 * i] = (data[i] >> 8) & 0xff;
+        p[2 * i + 1] = data[i] & 0xff;
+    }
+#ifdef _DEBUG_LOG
+    logRecord(p);
+#endif
+}
+
+void GDS::RecordWriter::writeInteger(Record_type type, int data)
+{
+    Byte *p = begin(type, Integer_4, 4);
+    p[0] = (data >> 24) & 0xff;
+    p[1] = (data >> 16) & 0xff;
+    p[2] = (data >> 8) & 0xff;
+    p[3] = data & 0xff;
+#ifdef _DEBUG_LOG
+    logRecord(p);
+#endif
+}
+
+void GDS::RecordWriter::writeDouble(Record_type type, double data)
+{
+    writeDoubles(type, &data, 1);
+}
+
+void GDS::RecordWriter::writeDoubles(Record_type type, const double *data, int num)
+{
+    Byte *p = begin(type, Real_8, 8 * num);
+    for (int i = 0; i < num; i++)
+    {
+        doubleToBytes(data[i], p + 8 * i);
+    }
+#ifdef _DEBUG_LOG
+    logRecord(p);
+#endif
+}
+
+void GDS::RecordWriter::writeString(Record_type type, const std::string &data)
+{
+    size_t length = data.size() + data.size() % 2;
+    Byte *p = begin(type, String, length);
+    memcpy(p, data.data(), data.size());
+    if (length != data.size())
+        p[length - 1] = '\0';
+#ifdef _DEBUG_LOG
+    logRecord(p);
+#endif
+}
+
+void GDS::RecordWriter::writeXY(const int *x, const int *y, int num)
+{
+    Byte *data = begin(XY, Integer_4, 8 * num);
+    Byte *p = data;
+    for (int i = 0; i < num; i++, p += 8)
+    {
+        unsigned int ux = (unsigned int)x[i];
+        unsigned int uy = (unsigned int)y[i];
+        p[0] = ux >> 24;
+        p[1] = (ux >> 16) & 0xff;
+        p[2] = (ux >> 8) & 0xff;
+        p[3] = ux & 0xff;
+        p[4] = uy >> 24;
+        p[5] = (uy >> 16) & 0xff;
+        p[6] = (uy >> 8) & 0xff;
+        p[7] = uy & 0xff;
+    }
+#ifdef _DEBUG_LOG
+    logRecord(data);
+#endif
+}
@@ -23,7 +23,10 @@
 #ifndef GDSIO_H
 #define GDSIO_H
 #include <fstream>
+#include <istream>
+#include <ostream>
 #include <string>
+#include <vector>
 #include "tags.h"
 
 namespace GDS {
@@ -55,6 +58,134 @@ void writeBitarray(std::ofstream &out, short data);
 
 std::string byteToString(Byte data);
 
+/*
+ * Decode big-endian values from a raw byte buffer.
+ **/
+short bytesToShort(const Byte *data);
+int bytesToInteger(const Byte *data);
+double bytesToDouble(const Byte *data);
+/*
+ * Encode a double as an 8-byte GDSII real. Values beyond the range of
+ * GDSII reals saturate, values below it flush to zero.
+ **/
+void doubleToBytes(double value, Byte *data);
+
+/*!
+ * \brief Decode a big-endian XY payload into separate X and Y arrays.
+ *
+ * The payload holds num pairs of 4-byte integers. The kernel byte-swaps
+ * and de-interleaves several points per instruction when the library is
+ * compiled with SSE2, SSSE3 or AVX2 enabled, and falls back to a portable
+ * scalar loop otherwise.
+ */
+void decodeXY(const Byte *data, int num, int *x, int *y);
+
+/*!
+ * \brief One GDSII record handed out by RecordReader.
+ *
+ * The payload points into the buffer of the reader and stays valid until
+ * the next call of RecordReader::next().
+ */
+struct Record
+{
+    unsigned short  size;           //< Size of the record, including the 4-byte header.
+    Byte            record_type;
+    Byte            data_type;
+    const Byte      *data;          //< Payload of (size - 4) bytes.
+
+    int length() const;
+    short getShort(int index = 0) const;
+    int getInteger(int index = 0) const;
+    double getDouble(int index = 0) const;
+    /*!
+     * The string payload without the trailing '\0' used to pad it
+     * to an even length.
+     */
+    std::string getString() const;
+};
+
+/*!
+ * \brief Block-buffered reader which splits a GDSII stream into records.
+ *
+ * The stream is pulled in large blocks into a reusable buffer so that
+ * every record costs a few pointer operations instead of one stream call
+ * per field. A reader can also be placed directly over a block of memory,
+ * e.g. a memory-mapped file, in which case records point into that memory
+ * and nothing is copied.
+ */
+class RecordReader
+{
+    std::istream        *In;            //< nullptr when reading from memory.
+    std::vector<Byte>   Buffer;
+    const Byte          *Data;          //< Buffer or the memory block.
+    size_t              Begin;          //< First unread byte in Data.
+    size_t              End;            //< One past the last valid byte in Data.
+    long long           Buffer_offset;  //< File offset of Data[0].
+    long long           Record_offset;  //< File offset of the current record.
+    Record              Current;
+
+    bool fill(size_t need);
+
+public:
+    RecordReader(std::istream &in, size_t block_size = 1 << 20);
+    /*!
+     * \param [in] data      The memory to parse. It must outlive the reader.
+     * \param [in] size      Size of the memory in bytes.
+     * \param [in] offset    File offset of data[0], used by offset().
+     */
+    RecordReader(const Byte *data, size_t size, long long offset = 0);
+
+    /*!
+     * \brief Advance to the next record.
+     *
+     * \return false if the end of the stream is reached. A truncated
+     *         record will throw FormatError.
+     */
+    bool next();
+    const Record& record() const;
+    long long offset() const;
+};
+
+/*!
+ * \brief Block-buffered writer which emits whole GDSII records.
+ *
+ * Every record is serialized with its header into an internal buffer in
+ * one step, and the buffer goes to the stream in large blocks. The
+ * remaining data is flushed by flush() or the destructor. A record whose
+ * payload exceeds 65531 bytes, e.g. an XY of more than 8191 points, does
+ * not fit the 16-bit size field and throws FormatError.
+ */
+class RecordWriter
+{
+    std::ostream        *Out;
+    std::vector<Byte>   Buffer;
+    size_t              Used;
+
+    Byte* begin(Byte record_type, Byte data_type, size_t length);
+
+public:
+    RecordWriter(std::ostream &out, size_t block_size = 1 << 20);
+    ~RecordWriter();
+
+    void flush();
+
+    void writeRecord(Record_type type);
+    void writeShort(Record_type type, short data);
+    void writeShorts(Record_type type, const short *data, int num);
+    void writeInteger(Record_type type, int data);
+    void writeDouble(Record_type type, double data);
+    void writeDoubles(Record_type type, const double *data, int num);
+    /*!
+     * The string is padded with '\0' to an even length.
+     */
+    void writeString(Record_type type, const std::string &data);
+    void writeXY(const int *x, const int *y, int num);
+    /*!
+     * Copy already encoded records to the output.
+     */
+    void writeRaw(const Byte *data, size_t size);
+};
+
 
 }
 
@@ -0,0 +1,361 @@
+/*
+ * This file is part of GDSII.
+ *
+ * geometry.cpp -- The source file which defines the boxes and transforms
+ *                 used to place structures.
+ *
+ * Copyright (c) 2015 Kangpeng Shao <billowen035@gmail.com>
+ *
+ * GDSII is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at you option) any later version.
+ *
+ * GDSII is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABLILTY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GDSII. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "geometry.h"
+
+namespace GDS
+{
+	Box::Box()
+	{
+		x_min = std::numeric_limits<int>::max();
+		y_min = std::numeric_limits<int>::max();
+		x_max = std::numeric_limits<int>::min();
+		y_max = std::numeric_limits<int>::min();
+	}
+
+	Box::Box(int x0, int y0, int x1, int y1)
+	{
+		x_min = std::min(x0, x1);
+		y_min = std::min(y0, y1);
+		x_max = std::max(x0, x1);
+		y_max = std::max(y0, y1);
+	}
+
+	bool Box::empty() const
+	{
+		return x_min > x_max || y_min > y_max;
+	}
+
+	void Box::add(int x, int y)
+	{
+		x_min = std::min(x_min, x);
+		y_min = std::min(y_min, y);
+		x_max = std::max(x_max, x);
+		y_max = std::max(y_max, y);
+	}
+
+	void Box::add(const Box &other)
+	{
+		if (other.empty())
+			return;
+		x_min = std::min(x_min, other.x_min);
+		y_min = std::min(y_min, other.y_min);
+		x_max = std::max(x_max, other.x_max);
+		y_max = std::max(y_max, other.y_max);
+	}
+
+	void Box::grow(int margin)
+	{
+		if (empty())
+			return;
+		long long lo = std::numeric_limits<int>::min(), hi = std::numeric_limits<int>::max();
+		x_min = (int)std::max(lo, (long long)x_min - margin);
+		y_min = (int)std::max(lo, (long long)y_min - margin);
+		x_max = (int)std::min(hi, (long long)x_max + margin);
+		y_max = (int)std::min(hi, (long long)y_max + margin);
+	}
+
+	bool Box::overlaps(const Box &other) const
+	{
+		if (empty() || other.empty())
+			return false;
+		return x_min <= other.x_max && other.x_min <= x_max
+			&& y_min <= other.y_max && other.y_min <= y_max;
+	}
+
+	bool Box::contains(const Box &other) const
+	{
+		if (empty() || other.empty())
+			return false;
+		return x_min <= other.x_min && other.x_max <= x_max
+			&& y_min <= other.y_min && other.y_max <= y_max;
+	}
+
+	bool Box::operator==(const Box &other) const
+	{
+		if (empty() && other.empty())
+			return true;
+		return x_min == other.x_min && y_min == other.y_min
+			&& x_max == other.x_max && y_max == other.y_max;
+	}
+
+	// Linear parts of the Manhattan orientations: A, B, C, D.
+	static const int Orientations[8][4] = {
+		{ 1, 0, 0, 1 }, { 0, -1, 1, 0 }, { -1, 0, 0, -1 }, { 0, 1, -1, 0 },
+		{ 1, 0, 0, -1 }, { 0, 1, 1, 0 }, { -1, 0, 0, 1 }, { 0, -1, -1, 0 }
+	};
+
+	static int clampInt(long long v)
+	{
+		if (v < std::numeric_limits<int>::min())
+			return std::numeric_limits<int>::min();
+		if (v > std::numeric_limits<int>::max())
+			return std::numeric_limits<int>::max();
+		return (int)v;
+	}
+
+	static int clampRound(double v)
+	{
+		v = std::floor(v + 0.5);
+		if (v < std::numeric_limits<int>::min())
+			return std::numeric_limits<int>::min();
+		if (v > std::numeric_limits<int>::max())
+			return std::numeric_limits<int>::max();
+		return (int)v;
+	}
+
+	Transform::Transform()
+	{
+		A = D = 1;
+		B = C = 0;
+		Tx = Ty = 0;
+		classify();
+	}
+
+	Transform::Transform(double x, double y, double angle, double mag, bool reflect)
+	{
+		double c, s;
+		double quarter = angle / 90;
+		if (quarter == std::floor(quarter))
+		{
+			// Exact values, so Manhattan placements stay on the grid.
+			static const double cos_table[4] = { 1, 0, -1, 0 };
+			static const double sin_table[4] = { 0, 1, 0, -1 };
+			int q = (int)std::fmod(quarter, 4.0);
+			if (q < 0)
+				q += 4;
+			c = cos_table[q];
+			s = sin_table[q];
+		}
+		else
+		{
+			double radians = angle * 3.14159265358979323846 / 180;
+			c = std::cos(radians);
+			s = std::sin(radians);
+		}
+		// Reflection negates y before the rotation.
+		double r = reflect ? -1 : 1;
+		A = mag * c;
+		B = -mag * s * r;
+		C = mag * s;
+		D = mag * c * r;
+		Tx = x;
+		Ty = y;
+		classify();
+	}
+
+	void Transform::classify()
+	{
+		Orientation = -1;
+		for (int o = 0; o < 8; o++)
+		{
+			const int *m = Orientations[o];
+			if (A == m[0] && B == m[1] && C == m[2] && D == m[3])
+			{
+				Orientation = o;
+				Ia = m[0];
+				Ib = m[1];
+				Ic = m[2];
+				Id = m[3];
+				break;
+			}
+		}
+		classifyOffset();
+	}
+
+	void Transform::classifyOffset()
+	{
+		if (Orientation < 0)
+			return;
+		if (Tx != std::floor(Tx) || Ty != std::floor(Ty)
+			|| Tx < std::numeric_limits<int>::min() || Tx > std::numeric_limits<int>::max()
+			|| Ty < std::numeric_limits<int>::min() || Ty > std::numeric_limits<int>::max())
+		{
+			Orientation = -1;
+			return;
+		}
+		Ix = (int)Tx;
+		Iy = (int)Ty;
+	}
+
+	void Transform::apply(double x, double y, double &out_x, double &out_y) const
+	{
+		out_x = A * x + B * y + Tx;
+		out_y = C * x + D * y + Ty;
+	}
+
+	void Transform::apply(int x, int y, int &out_x, int &out_y) const
+	{
+		if (Orientation >= 0)
+		{
+			out_x = clampInt((long long)Ia * x + (long long)Ib * y + Ix);
+			out_y = clampInt((long long)Ic * x + (long long)Id * y + Iy);
+			return;
+		}
+		double tx, ty;
+		apply((double)x, (double)y, tx, ty);
+		out_x = clampRound(tx);
+		out_y = clampRound(ty);
+	}
+
+	void Transform::apply(const int *x, const int *y, size_t count, int *out_x, int *out_y) const
+	{
+		if (Orientation >= 0)
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+				long long px = x[i], py = y[i];
+				out_x[i] = clampInt(Ia * px + Ib * py + Ix);
+				out_y[i] = clampInt(Ic * px + Id * py + Iy);
+			}
+			return;
+		}
+		for (size_t i = 0; i < count; i++)
+		{
+			double px = x[i], py = y[i];
+			out_x[i] = clampRound(A * px + B * py + Tx);
+			out_y[i] = clampRound(C * px + D * py + Ty);
+		}
+	}
+
+	void Transform::applyLinear(double x, double y, double &out_x, double &out_y) const
+	{
+		out_x = A * x + B * y;
+		out_y = C * x + D * y;
+	}
+
+	static int clampFloor(double v)
+	{
+		v = std::floor(v);
+		if (v < std::numeric_limits<int>::min())
+			return std::numeric_limits<int>::min();
+		if (v > std::numeric_limits<int>::max())
+			return std::numeric_limits<int>::max();
+		return (int)v;
+	}
+
+	static int clampCeil(double v)
+	{
+		v = std::ceil(v);
+		if (v < std::numeric_limits<int>::min())
+			return std::numeric_limits<int>::min();
+		if (v > std::numeric_limits<int>::max())
+			return std::numeric_limits<int>::max();
+		return (int)v;
+	}
+
+	Box Transform::apply(const Box &box) const
+	{
+		if (box.empty())
+			return box;
+		if (Orientation >= 0)
+		{
+			int x0, y0, x1, y1;
+			apply(box.x_min, box.y_min, x0, y0);
+			apply(box.x_max, box.y_max, x1, y1);
+			return Box(x0, y0, x1, y1);
+		}
+		double xs[4], ys[4];
+		apply(box.x_min, box.y_min, xs[0], ys[0]);
+		apply(box.x_max, box.y_min, xs[1], ys[1]);
+		apply(box.x_min, box.y_max, xs[2], ys[2]);
+		apply(box.x_max, box.y_max, xs[3], ys[3]);
+		Box result;
+		result.x_min = clampFloor(*std::min_element(xs, xs + 4));
+		result.y_min = clampFloor(*std::min_element(ys, ys + 4));
+		result.x_max = clampCeil(*std::max_element(xs, xs + 4));
+		result.y_max = clampCeil(*std::max_element(ys, ys + 4));
+		return result;
+	}
+
+	Transform Transform::operator*(const Transform &other) const
+	{
+		Transform t;
+		t.A = A * other.A + B * other.C;
+		t.B = A * other.B + B * other.D;
+		t.C = C * other.A + D * other.C;
+		t.D = C * other.B + D * other.D;
+		t.Tx = A * other.Tx + B * other.Ty + Tx;
+		t.Ty = C * other.Tx + D * other.Ty + Ty;
+		t.classify();
+		return t;
+	}
+
+	Transform Transform::inverse() const
+	{
+		Transform t;
+		double det = A * D - B * C;
+		if (det == 0)
+			return t;
+		if (Orientation >= 0)
+		{
+			// The inverse of a rotation or reflection is its transpose, so
+			// it stays exact.
+			t.A = A;
+			t.B = C;
+			t.C = B;
+			t.D = D;
+		}
+		else
+		{
+			t.A = D / det;
+			t.B = -B / det;
+			t.C = -C / det;
+			t.D = A / det;
+		}
+		t.Tx = -(t.A * Tx + t.B * Ty);
+		t.Ty = -(t.C * Tx + t.D * Ty);
+		t.classify();
+		return t;
+	}
+
+	double Transform::scale() const
+	{
+		return std::sqrt(std::fabs(A * D - B * C));
+	}
+
+	Transform& Transform::translate(double x, double y)
+	{
+		Tx += x;
+		Ty += y;
+		classify();
+		return *this;
+	}
+
+	bool Transform::isManhattan() const
+	{
+		return Orientation >= 0;
+	}
+
+	bool Transform::isRectilinear() const
+	{
+		return (B == 0 && C == 0) || (A == 0 && D == 0);
+	}
+
+	int Transform::orientation() const
+	{
+		return Orientation;
+	}
+}
@@ -0,0 +1,155 @@
+/*
+ * This file is part of GDSII.
+ *
+ * geometry.h -- The header file which declare the boxes and transforms
+ *               used to place structures.
+ *
+ * Copyright (c) 2015 Kangpeng Shao <billowen035@gmail.com>
+ *
+ * GDSII is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at you option) any later version.
+ *
+ * GDSII is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABLILTY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GDSII. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef GDS_GEOMETRY_H
+#define GDS_GEOMETRY_H
+
+#include <cstddef>
+
+namespace GDS
+{
+	/*!
+	 * \brief Axis aligned box in database units.
+	 *
+	 * A default box is empty; adding points and boxes grows it.
+	 */
+	struct Box
+	{
+		int     x_min;
+		int     y_min;
+		int     x_max;
+		int     y_max;
+
+		Box();
+		Box(int x0, int y0, int x1, int y1);
+
+		bool empty() const;
+		void add(int x, int y);
+		void add(const Box &other);
+		/*!
+		 * Move every side outwards, stopping at the range of int.
+		 */
+		void grow(int margin);
+		bool overlaps(const Box &other) const;
+		bool contains(const Box &other) const;
+		bool operator==(const Box &other) const;
+	};
+
+	/*!
+	 * \brief Placement of a referenced structure.
+	 *
+	 * A point p of the child goes to rotate(mag * reflect(p)) + origin, as
+	 * GDSII describes the STRANS, MAG and ANGLE records of SREF and AREF.
+	 * Rotations by multiples of 90 degrees are kept exact.
+	 *
+	 * A transform without magnification, rotated by a multiple of 90
+	 * degrees and moved by whole database units is Manhattan: it maps the
+	 * grid onto itself, and integer points go through it with integer
+	 * arithmetic only. Nearly all placements in real layouts are of that
+	 * kind; the others take the floating point path.
+	 */
+	class Transform
+	{
+		double  A, B, C, D;     //< Linear part: x' = A x + B y, y' = C x + D y.
+		double  Tx, Ty;
+		int     Orientation;    //< 0 to 7 if Manhattan, -1 otherwise.
+		int     Ia, Ib, Ic, Id; //< Linear part of a Manhattan transform.
+		int     Ix, Iy;         //< Offset of a Manhattan transform.
+
+		void classify();
+		void classifyOffset();
+
+	public:
+		/*!
+		 * The identity.
+		 */
+		Transform();
+		/*!
+		 * \param [in] x, y			Origin of the placement.
+		 * \param [in] angle		Counterclockwise rotation in degrees.
+		 * \param [in] mag			Magnification.
+		 * \param [in] reflect		Reflect about the x axis before rotating.
+		 */
+		Transform(double x, double y, double angle, double mag, bool reflect);
+
+		void apply(double x, double y, double &out_x, double &out_y) const;
+		/*!
+		 * \brief Transform a point to the nearest database unit.
+		 *
+		 * Exact for Manhattan transforms. Results beyond the range of int
+		 * are clamped.
+		 */
+		void apply(int x, int y, int &out_x, int &out_y) const;
+		/*!
+		 * \brief Transform an array of points to the nearest database units.
+		 *
+		 * The output arrays may be the input arrays.
+		 */
+		void apply(const int *x, const int *y, size_t count, int *out_x, int *out_y) const;
+		/*!
+		 * Apply the linear part only, for vectors.
+		 */
+		void applyLinear(double x, double y, double &out_x, double &out_y) const;
+		/*!
+		 * \brief The box of the transformed corners of a box.
+		 *
+		 * The result is rounded outwards to database units, so it always
+		 * covers the transformed box.
+		 */
+		Box apply(const Box &box) const;
+		/*!
+		 * \brief Apply other first, then this transform.
+		 */
+		Transform operator*(const Transform &other) const;
+		/*!
+		 * \brief The transform which undoes this one.
+		 *
+		 * A transform with zero magnification has no inverse; the identity
+		 * is returned for it.
+		 */
+		Transform inverse() const;
+		/*!
+		 * The magnification, which scales widths and lengths.
+		 */
+		double scale() const;
+		Transform& translate(double x, double y);
+
+		bool isManhattan() const;
+		/*!
+		 * \brief Whether axis aligned boxes stay axis aligned.
+		 *
+		 * True for rotations by multiples of 90 degrees with any
+		 * magnification or offset.
+		 */
+		bool isRectilinear() const;
+		/*!
+		 * \brief The Manhattan orientation.
+		 *
+		 * \return	The rotation in quarter turns counterclockwise, plus 4 if
+		 *			y is reflected first; -1 if the transform is not
+		 *			Manhattan.
+		 */
+		int orientation() const;
+	};
+}
+
+#endif
@@ -0,0 +1,236 @@
+/*
+ * This file is part of GDSII.
+ *
+ * hierarchy.cpp -- The source file which defines the graph of structure
+ *                  references of a library.
+ *
+ * Copyright (c) 2015 Kangpeng Shao <billowen035@gmail.com>
+ *
+ * GDSII is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at you option) any later version.
+ *
+ * GDSII is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABLILTY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GDSII. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#include <algorithm>
+#include "hierarchy.h"
+#include "library.h"
+#include "parallel.h"
+#include "structures.h"
+
+namespace GDS
+{
+	// Collects the references of one parent, merging repeated children.
+	struct ReferenceCollector : ElementVisitor
+	{
+		const std::unordered_map<const Structure*, size_t>  &Positions;
+		std::vector<HierarchyEdge>                          &Edges;
+		std::vector<size_t>                                 &Last_parent;  // Parent which last saw the cell, + 1.
+		std::vector<size_t>                                 &Edge_index;
+		size_t                                              Parent;
+
+		ReferenceCollector(const std::unordered_map<const Structure*, size_t> &positions,
+			std::vector<HierarchyEdge> &edges, std::vector<size_t> &last_parent,
+			std::vector<size_t> &edge_index, size_t parent)
+			: Positions(positions), Edges(edges), Last_parent(last_parent),
+			Edge_index(edge_index), Parent(parent) {}
+
+		void add(Structure *target, unsigned long long count)
+		{
+			if (target == nullptr || count == 0)
+				return;
+			auto it = Positions.find(target);
+			if (it == Positions.end())
+				return;
+			size_t child = it->second;
+			if (Last_parent[child] == Parent + 1)
+			{
+				Edges[Edge_index[child]].count += count;
+				return;
+			}
+			Last_parent[child] = Parent + 1;
+			Edge_index[child] = Edges.size();
+			HierarchyEdge edge = { child, count };
+			Edges.push_back(edge);
+		}
+
+		void sref(SRef &node)
+		{
+			add(node.target(), 1);
+		}
+
+		void aref(ARef &node)
+		{
+			if (node.row() > 0 && node.col() > 0)
+				add(node.target(), (unsigned long long)node.row() * node.col());
+		}
+	};
+
+	Hierarchy::Hierarchy()
+	{
+	}
+
+	Hierarchy::Hierarchy(Library *lib)
+	{
+		build(lib);
+	}
+
+	void Hierarchy::build(Library *lib)
+	{
+		Cells.clear();
+		Positions.clear();
+		Children.clear();
+		Parents.clear();
+		Order.clear();
+		Tops.clear();
+		Instances.clear();
+
+		size_t n = lib->size();
+		Cells.reserve(n);
+		Positions.reserve(n);
+		for (size_t i = 0; i < n; i++)
+		{
+			Structure *cell = lib->get((int)i);
+			if (cell != nullptr && Positions.insert(std::make_pair(cell, Cells.size())).second)
+				Cells.push_back(cell);
+		}
+		n = Cells.size();
+
+		Children.resize(n);
+		Parents.resize(n);
+		std::vector<size_t> last_parent(n, 0), edge_index(n, 0);
+		for (size_t i = 0; i < n; i++)
+		{
+			ReferenceCollector collector(Positions, Children[i], last_parent, edge_index, i);
+			Cells[i]->visit(collector);
+			for (const HierarchyEdge &edge : Children[i])
+			{
+				HierarchyEdge back = { i, edge.count };
+				Parents[edge.cell].push_back(back);
+			}
+		}
+
+		for (size_t i = 0; i < n; i++)
+		{
+			if (Parents[i].empty())
+				Tops.push_back(i);
+		}
+
+		// Kahn's algorithm from the leaves up.
+		std::vector<size_t> pending(n);
+		Order.reserve(n);
+		for (size_t i = 0; i < n; i++)
+		{
+			pending[i] = Children[i].size();
+			if (pending[i] == 0)
+				Order.push_back(i);
+		}
+		for (size_t k = 0; k < Order.size(); k++)
+		{
+			for (const HierarchyEdge &edge : Parents[Order[k]])
+			{
+				if (--pending[edge.cell] == 0)
+					Order.push_back(edge.cell);
+			}
+		}
+
+		// Propagate the counts from the tops down, parents before children.
+		Instances.assign(n, 0);
+		for (size_t i : Tops)
+			Instances[i] = 1;
+		for (size_t k = Order.size(); k-- > 0;)
+		{
+			size_t cell = Order[k];
+			if (Instances[cell] == 0)
+				continue;
+			for (const HierarchyEdge &edge : Children[cell])
+				Instances[edge.cell] += Instances[cell] * edge.count;
+		}
+	}
+
+	size_t Hierarchy::size() const
+	{
+		return Cells.size();
+	}
+
+	Structure* Hierarchy::structure(size_t cell) const
+	{
+		return Cells[cell];
+	}
+
+	size_t Hierarchy::index(const Structure *structure) const
+	{
+		auto it = Positions.find(structure);
+		if (it == Positions.end())
+			return Cells.size();
+		return it->second;
+	}
+
+	const std::vector<HierarchyEdge>& Hierarchy::children(size_t cell) const
+	{
+		return Children[cell];
+	}
+
+	const std::vector<HierarchyEdge>& Hierarchy::parents(size_t cell) const
+	{
+		return Parents[cell];
+	}
+
+	const std::vector<size_t>& Hierarchy::order() const
+	{
+		return Order;
+	}
+
+	bool Hierarchy::isAcyclic() const
+	{
+		return Order.size() == Cells.size();
+	}
+
+	const std::vector<size_t>& Hierarchy::tops() const
+	{
+		return Tops;
+	}
+
+	unsigned long long Hierarchy::instances(size_t cell) const
+	{
+		return Instances[cell];
+	}
+
+	void Hierarchy::computeHashes(int threads) const
+	{
+		if (!isAcyclic())
+		{
+			for (Structure *cell : Cells)
+				cell->hash();
+			return;
+		}
+
+		// The level of a cell is one above its highest child, so the cells
+		// of a level only reference lower ones.
+		std::vector<size_t> level(Cells.size(), 0);
+		std::vector<std::vector<Structure*> > levels;
+		for (size_t cell : Order)
+		{
+			for (const HierarchyEdge &edge : Children[cell])
+				level[cell] = std::max(level[cell], level[edge.cell] + 1);
+			if (level[cell] >= levels.size())
+				levels.resize(level[cell] + 1);
+			levels[level[cell]].push_back(Cells[cell]);
+		}
+		for (const std::vector<Structure*> &cells : levels)
+		{
+			parallelFor(cells.size(), threads, [&](size_t i)
+			{
+				cells[i]->hash();
+			});
+		}
+	}
+}
@@ -0,0 +1,120 @@
+/*
+ * This file is part of GDSII.
+ *
+ * hierarchy.h -- The header file which declare the graph of structure
+ *                references of a library.
+ *
+ * Copyright (c) 2015 Kangpeng Shao <billowen035@gmail.com>
+ *
+ * GDSII is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at you option) any later version.
+ *
+ * GDSII is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABLILTY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GDSII. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef GDS_HIERARCHY_H
+#define GDS_HIERARCHY_H
+
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+
+namespace GDS
+{
+	class Library;
+	class Structure;
+
+	/*!
+	 * \brief A reference between two cells of a Hierarchy.
+	 *
+	 * All references from one parent to one child are merged. An AREF
+	 * counts with its rows times its columns.
+	 */
+	struct HierarchyEdge
+	{
+		size_t              cell;       //< Position of the other cell in the hierarchy.
+		unsigned long long  count;      //< Number of placements.
+	};
+
+	/*!
+	 * \brief The structures of a library as a directed acyclic graph.
+	 *
+	 * The graph is a snapshot: it is built from the resolved references of
+	 * a library in time linear in the number of elements, and does not
+	 * follow later edits. Cells are numbered in the order of the library.
+	 */
+	class Hierarchy
+	{
+		std::vector<Structure*>                     Cells;
+		std::unordered_map<const Structure*, size_t> Positions;
+		std::vector<std::vector<HierarchyEdge> >    Children;
+		std::vector<std::vector<HierarchyEdge> >    Parents;
+		std::vector<size_t>                         Order;      //< Children before parents.
+		std::vector<size_t>                         Tops;
+		std::vector<unsigned long long>             Instances;
+
+	public:
+		Hierarchy();
+		Hierarchy(Library *lib);
+
+		/*!
+		 * \brief Rebuild the graph from a library.
+		 *
+		 * Every structure of the library is loaded.
+		 */
+		void build(Library *lib);
+
+		size_t size() const;
+		Structure* structure(size_t cell) const;
+		/*!
+		 * \return	The position of the structure, or size() if it is not
+		 *			in the hierarchy.
+		 */
+		size_t index(const Structure *structure) const;
+
+		const std::vector<HierarchyEdge>& children(size_t cell) const;
+		const std::vector<HierarchyEdge>& parents(size_t cell) const;
+
+		/*!
+		 * \brief The cells in topological order, children first.
+		 *
+		 * Walking it forwards visits every cell after all of its children,
+		 * walking it backwards before all of its parents. Cells on a
+		 * reference cycle, which GDSII does not allow, are left out.
+		 */
+		const std::vector<size_t>& order() const;
+		bool isAcyclic() const;
+		/*!
+		 * Cells which no other cell references, in library order.
+		 */
+		const std::vector<size_t>& tops() const;
+		/*!
+		 * \brief How often a cell appears when all top cells are flattened.
+		 *
+		 * Top cells count once. Cells on a reference cycle count 0. Counts
+		 * beyond 2^64 wrap around.
+		 */
+		unsigned long long instances(size_t cell) const;
+		/*!
+		 * \brief Fill the Structure::hash() caches of all cells.
+		 *
+		 * The cells are hashed bottom-up, level by level, the cells of
+		 * one level on several threads; each reads only the cached hashes
+		 * of its children. A hierarchy with a cycle is hashed on one
+		 * thread.
+		 *
+		 * \param [in] threads		Number of threads, 0 for defaultThreads().
+		 */
+		void computeHashes(int threads = 0) const;
+	};
+}
+
+#endif
@@ -0,0 +1,165 @@
+/*
+ * This file is part of GDSII.
+ *
+ * iotest.cpp -- Tests of the record reader and writer and of the ways to
+ *               read a library.
+ *
+ * Copyright (c) 2015 Kangpeng Shao <billowen035@gmail.com>
+ *
+ * GDSII is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at you option) any later version.
+ *
+ * GDSII is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABLILTY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GDSII. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "gdsio.h"
+#include "exceptions.h"
+
+using GDS::Byte;
+
+static int Failures = 0;
+
+static void check(bool ok, const std::string &what)
+{
+    if (!ok)
+    {
+        Failures++;
+        std::cout << "FAIL " << what << std::endl;
+    }
+}
+
+/*
+ * Records of every data type, with XY records up to the largest legal one,
+ * often enough to flush the writer several times.
+ **/
+static void writeRecords(std::ostream &out, int rounds)
+{
+    GDS::RecordWriter writer(out);
+    writer.writeShort(GDS::HEADER, 600);
+    short dates[12] = {2015, 1, 2, 3, 4, 5, 2015, 6, 7, 8, 9, 10};
+    writer.writeShorts(GDS::BGNLIB, dates, 12);
+    writer.writeString(GDS::LIBNAME, "LIB");
+    double units[2] = {0.001, 1e-9};
+    writer.writeDoubles(GDS::UNITS, units, 2);
+    for (int r = 0; r < rounds; r++)
+    {
+        int count = r % 2 == 0 ? 8191 : 1 + r;
+        std::vector<int> x(count), y(count);
+        for (int i = 0; i < count; i++)
+        {
+            x[i] = i * 7 - r;
+            y[i] = -i * 13 + r * 1000003;
+        }
+        writer.writeXY(x.data(), y.data(), count);
+        writer.writeInteger(GDS::WIDTH, -r);
+    }
+    writer.writeRecord(GDS::ENDLIB);
+}
+
+static void readRecords(GDS::RecordReader &reader, int rounds, const std::string &how)
+{
+    const GDS::Record &rec = reader.record();
+    bool ok = reader.next() && rec.record_type == GDS::HEADER && rec.getShort() == 600;
+    ok = ok && reader.next() && rec.record_type == GDS::BGNLIB && rec.length() == 24
+        && rec.getShort(0) == 2015 && rec.getShort(11) == 10;
+    ok = ok && reader.next() && rec.record_type == GDS::LIBNAME && rec.length() == 4 && rec.getString() == "LIB";
+    ok = ok && reader.next() && rec.record_type == GDS::UNITS
+        && rec.getDouble(0) == 0.001 && rec.getDouble(1) == 1e-9;
+    check(ok, how + ": library records");
+    for (int r = 0; ok && r < rounds; r++)
+    {
+        int count = r % 2 == 0 ? 8191 : 1 + r;
+        ok = reader.next() && rec.record_type == GDS::XY && rec.data_type == GDS::Integer_4
+            && rec.length() == 8 * count;
+        std::vector<int> x(count), y(count);
+        if (ok)
+            GDS::decodeXY(rec.data, count, x.data(), y.data());
+        for (int i = 0; ok && i < count; i++)
+            ok = x[i] == i * 7 - r && y[i] == -i * 13 + r * 1000003;
+        ok = ok && reader.next() && rec.record_type == GDS::WIDTH && rec.getInteger() == -r;
+        check(ok, how + ": XY round " + std::to_string(r));
+    }
+    check(reader.next() && rec.record_type == GDS::ENDLIB, how + ": ENDLIB");
+    check(!reader.next(), how + ": end of stream");
+}
+
+static void testRoundTrip()
+{
+    const int rounds = 200;
+    std::stringstream out;
+    writeRecords(out, rounds);
+    std::string data = out.str();
+
+    // A small block makes the stream reader refill inside records.
+    std::istringstream in(data);
+    GDS::RecordReader stream_reader(in, 4096);
+    readRecords(stream_reader, rounds, "stream");
+    GDS::RecordReader memory_reader((const Byte*)data.data(), data.size());
+    readRecords(memory_reader, rounds, "memory");
+}
+
+static bool throwsFormatError(void (*write)(GDS::RecordWriter &writer))
+{
+    std::stringstream out;
+    GDS::RecordWriter writer(out);
+    try
+    {
+        write(writer);
+    }
+    catch (GDS::FormatError &)
+    {
+        return true;
+    }
+    return false;
+}
+
+/*
+ * Payloads which do not fit the 16-bit size field of a record.
+ **/
+static void testTooLong()
+{
+    check(throwsFormatError([](GDS::RecordWriter &writer)
+    {
+        std::vector<int> x(8192), y(8192);
+        writer.writeXY(x.data(), y.data(), 8192);
+    }), "XY of 8192 points");
+    check(throwsFormatError([](GDS::RecordWriter &writer)
+    {
+        std::vector<int> x(200000), y(200000);
+        writer.writeXY(x.data(), y.data(), 200000);
+    }), "XY of 200000 points");
+    check(throwsFormatError([](GDS::RecordWriter &writer)
+    {
+        // Padded to an even 65532 bytes.
+        writer.writeString(GDS::STRING, std::string(65531, 'a'));
+    }), "string of 65531 bytes");
+    check(!throwsFormatError([](GDS::RecordWriter &writer)
+    {
+        writer.writeString(GDS::STRING, std::string(65530, 'a'));
+    }), "string of 65530 bytes");
+}
+
+int main()
+{
+    testRoundTrip();
+    testTooLong();
+    if (Failures > 0)
+    {
+        std::cout << Failures << " failures" << std::endl;
+        return 1;
+    }
+    std::cout << "all passed" << std::endl;
+    return 0;
+}
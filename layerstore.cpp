@@ -0,0 +1,289 @@
+/*
+ * This file is part of GDSII.
+ *
+ * layerstore.cpp -- The source file which defines the columnar copy of the
+ *                   shapes of a structure, grouped by layer.
+ *
+ * Copyright (c) 2015 Kangpeng Shao <billowen035@gmail.com>
+ *
+ * GDSII is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at you option) any later version.
+ *
+ * GDSII is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABLILTY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GDSII. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#include <algorithm>
+#include <unordered_map>
+#include "layerstore.h"
+#include "structures.h"
+#include "boundary.h"
+#include "path.h"
+#include "text.h"
+
+namespace GDS
+{
+	LayerShapes::LayerShapes(short layer, short data_type)
+	{
+		Layer = layer;
+		Data_type = data_type;
+		Boundary_offsets.push_back(0);
+		Path_offsets.push_back(0);
+	}
+
+	short LayerShapes::layer() const
+	{
+		return Layer;
+	}
+
+	short LayerShapes::dataType() const
+	{
+		return Data_type;
+	}
+
+	size_t LayerShapes::vertexCount() const
+	{
+		return X.size();
+	}
+
+	const int* LayerShapes::x() const
+	{
+		return X.data();
+	}
+
+	const int* LayerShapes::y() const
+	{
+		return Y.data();
+	}
+
+	size_t LayerShapes::boundaryCount() const
+	{
+		return Boundary_offsets.size() - 1;
+	}
+
+	PointRange LayerShapes::boundary(size_t index) const
+	{
+		size_t begin = Boundary_offsets[index];
+		PointRange range = { X.data() + begin, Y.data() + begin, Boundary_offsets[index + 1] - begin };
+		return range;
+	}
+
+	size_t LayerShapes::pathCount() const
+	{
+		return Path_offsets.size() - 1;
+	}
+
+	PointRange LayerShapes::path(size_t index) const
+	{
+		size_t begin = Path_offsets[index];
+		PointRange range = { X.data() + begin, Y.data() + begin, Path_offsets[index + 1] - begin };
+		return range;
+	}
+
+	int LayerShapes::pathWidth(size_t index) const
+	{
+		return Path_widths[index];
+	}
+
+	short LayerShapes::pathType(size_t index) const
+	{
+		return Path_types[index];
+	}
+
+	void LayerShapes::pathExtension(size_t index, int &begin, int &end) const
+	{
+		begin = Path_extensions[2 * index];
+		end = Path_extensions[2 * index + 1];
+	}
+
+	size_t LayerShapes::textCount() const
+	{
+		return Text_x.size();
+	}
+
+	void LayerShapes::text(size_t index, int &x, int &y) const
+	{
+		x = Text_x[index];
+		y = Text_y[index];
+	}
+
+	double LayerShapes::area() const
+	{
+		double total = 0;
+		for (size_t i = 0; i + 1 < Boundary_offsets.size(); i++)
+		{
+			size_t begin = Boundary_offsets[i];
+			size_t end = Boundary_offsets[i + 1];
+			if (end - begin < 3)
+				continue;
+			// Shoelace formula; the closing vertex of GDS makes the sum wrap.
+			long long twice = 0;
+			for (size_t j = begin; j + 1 < end; j++)
+				twice += (long long)X[j] * Y[j + 1] - (long long)X[j + 1] * Y[j];
+			twice += (long long)X[end - 1] * Y[begin] - (long long)X[begin] * Y[end - 1];
+			total += (twice < 0 ? -twice : twice) * 0.5;
+		}
+		return total;
+	}
+
+	bool LayerShapes::bounds(int &x_min, int &y_min, int &x_max, int &y_max) const
+	{
+		if (X.empty() && Text_x.empty())
+			return false;
+		int x0 = 0x7fffffff, y0 = 0x7fffffff;
+		int x1 = -x0 - 1, y1 = -y0 - 1;
+		for (size_t i = 0; i < X.size(); i++)
+		{
+			x0 = std::min(x0, X[i]);
+			x1 = std::max(x1, X[i]);
+		}
+		for (size_t i = 0; i < Y.size(); i++)
+		{
+			y0 = std::min(y0, Y[i]);
+			y1 = std::max(y1, Y[i]);
+		}
+		for (size_t i = 0; i < Text_x.size(); i++)
+		{
+			x0 = std::min(x0, Text_x[i]);
+			x1 = std::max(x1, Text_x[i]);
+			y0 = std::min(y0, Text_y[i]);
+			y1 = std::max(y1, Text_y[i]);
+		}
+		x_min = x0;
+		y_min = y0;
+		x_max = x1;
+		y_max = y1;
+		return true;
+	}
+
+	static int layerKey(short layer, short data_type)
+	{
+		return ((int)(unsigned short)layer << 16) | (unsigned short)data_type;
+	}
+
+	// Visitor of LayerStore::build(). The first pass finds the layers and
+	// counts their vertices, the second copies the boundaries, the third
+	// the paths and texts behind them.
+	struct LayerBuilder : ElementVisitor
+	{
+		std::vector<LayerShapes>            &Layers;
+		std::unordered_map<int, size_t>     Slots;      // (layer, datatype) to position in Layers.
+		std::vector<size_t>                 Vertices;
+		int                                 Pass;
+
+		LayerBuilder(std::vector<LayerShapes> &layers) : Layers(layers), Pass(1) {}
+
+		LayerShapes& find(short layer, short data_type, size_t count)
+		{
+			auto it = Slots.find(layerKey(layer, data_type));
+			if (it == Slots.end())
+			{
+				it = Slots.insert(std::make_pair(layerKey(layer, data_type), Layers.size())).first;
+				Layers.push_back(LayerShapes(layer, data_type));
+				Vertices.push_back(0);
+			}
+			if (Pass == 1)
+				Vertices[it->second] += count;
+			return Layers[it->second];
+		}
+
+		void boundary(Boundary &node)
+		{
+			LayerShapes &shapes = find(node.layer(), node.dataType(), node.pointCount());
+			if (Pass != 2)
+				return;
+			shapes.X.insert(shapes.X.end(), node.xData(), node.xData() + node.pointCount());
+			shapes.Y.insert(shapes.Y.end(), node.yData(), node.yData() + node.pointCount());
+			shapes.Boundary_offsets.push_back(shapes.X.size());
+		}
+
+		void path(Path &node)
+		{
+			LayerShapes &shapes = find(node.layer(), node.dataType(), node.pointCount());
+			if (Pass != 3)
+				return;
+			shapes.X.insert(shapes.X.end(), node.xData(), node.xData() + node.pointCount());
+			shapes.Y.insert(shapes.Y.end(), node.yData(), node.yData() + node.pointCount());
+			shapes.Path_offsets.push_back(shapes.X.size());
+			shapes.Path_widths.push_back(node.width());
+			shapes.Path_types.push_back((short)node.pathType());
+			int begin, end;
+			node.extension(begin, end);
+			shapes.Path_extensions.push_back(begin);
+			shapes.Path_extensions.push_back(end);
+		}
+
+		void text(Text &node)
+		{
+			LayerShapes &shapes = find(node.layer(), node.textType(), 0);
+			if (Pass != 3)
+				return;
+			int x, y;
+			node.xy(x, y);
+			shapes.Text_x.push_back(x);
+			shapes.Text_y.push_back(y);
+		}
+	};
+
+	void LayerStore::build(Structure *structure)
+	{
+		Layers.clear();
+
+		LayerBuilder builder(Layers);
+		structure->visit(builder);
+		for (size_t i = 0; i < Layers.size(); i++)
+		{
+			Layers[i].X.reserve(builder.Vertices[i]);
+			Layers[i].Y.reserve(builder.Vertices[i]);
+		}
+		builder.Pass = 2;
+		structure->visit(builder);
+		for (LayerShapes &shapes : Layers)
+			shapes.Path_offsets[0] = shapes.X.size();
+		builder.Pass = 3;
+		structure->visit(builder);
+
+		std::sort(Layers.begin(), Layers.end(), [](const LayerShapes &a, const LayerShapes &b)
+		{
+			if (a.Layer != b.Layer)
+				return a.Layer < b.Layer;
+			return a.Data_type < b.Data_type;
+		});
+	}
+
+	void LayerStore::clear()
+	{
+		Layers.clear();
+	}
+
+	size_t LayerStore::size() const
+	{
+		return Layers.size();
+	}
+
+	const LayerShapes& LayerStore::get(size_t index) const
+	{
+		return Layers[index];
+	}
+
+	const LayerShapes* LayerStore::find(short layer, short data_type) const
+	{
+		auto it = std::lower_bound(Layers.begin(), Layers.end(), std::make_pair(layer, data_type),
+			[](const LayerShapes &a, const std::pair<short, short> &key)
+		{
+			if (a.Layer != key.first)
+				return a.Layer < key.first;
+			return a.Data_type < key.second;
+		});
+		if (it == Layers.end() || it->Layer != layer || it->Data_type != data_type)
+			return nullptr;
+		return &*it;
+	}
+}
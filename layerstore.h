@@ -0,0 +1,133 @@
+/*
+ * This file is part of GDSII.
+ *
+ * layerstore.h -- The header file which declare the columnar copy of the
+ *                 shapes of a structure, grouped by layer.
+ *
+ * Copyright (c) 2015 Kangpeng Shao <billowen035@gmail.com>
+ *
+ * GDSII is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at you option) any later version.
+ *
+ * GDSII is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABLILTY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GDSII. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef GDS_LAYERSTORE_H
+#define GDS_LAYERSTORE_H
+
+#include <cstddef>
+#include <vector>
+
+namespace GDS
+{
+	class Structure;
+	struct LayerBuilder;
+
+	/*!
+	 * \brief Read-only view of the vertices of one polygon or path.
+	 */
+	struct PointRange
+	{
+		const int*  X;
+		const int*  Y;
+		size_t      Count;
+	};
+
+	/*!
+	 * \brief The boundaries, paths and texts of one (layer, datatype).
+	 *
+	 * All vertices live in one pool, stored as an x column and a y column:
+	 * first the boundaries, then the paths, each in the order of the
+	 * structure. Shape i of a kind covers the pool range
+	 * [offsets[i], offsets[i + 1]), so a pass over a whole layer reads
+	 * memory in order.
+	 */
+	class LayerShapes
+	{
+		friend class LayerStore;
+		friend struct LayerBuilder;
+
+		short               Layer;
+		short               Data_type;
+		std::vector<int>    X, Y;                   //< Vertex pool.
+		std::vector<size_t> Boundary_offsets;
+		std::vector<size_t> Path_offsets;
+		std::vector<int>    Path_widths;
+		std::vector<short>  Path_types;
+		std::vector<int>    Path_extensions;        //< Begin and end of each path.
+		std::vector<int>    Text_x, Text_y;
+
+	public:
+		LayerShapes(short layer = 0, short data_type = 0);
+
+		short layer() const;
+		short dataType() const;
+
+		size_t vertexCount() const;
+		const int* x() const;
+		const int* y() const;
+
+		size_t boundaryCount() const;
+		PointRange boundary(size_t index) const;
+
+		size_t pathCount() const;
+		PointRange path(size_t index) const;
+		int pathWidth(size_t index) const;
+		short pathType(size_t index) const;
+		void pathExtension(size_t index, int &begin, int &end) const;
+
+		/*!
+		 * Texts of the layer are matched by their TEXTTYPE.
+		 */
+		size_t textCount() const;
+		void text(size_t index, int &x, int &y) const;
+
+		/*!
+		 * \brief Total area of the boundaries, in squared database units.
+		 *
+		 * Every boundary counts with its own absolute area, overlaps are not
+		 * merged.
+		 */
+		double area() const;
+		/*!
+		 * \brief Box of all vertices and text origins of the layer.
+		 *
+		 * The width of paths is not included.
+		 *
+		 * \return	false if the layer is empty.
+		 */
+		bool bounds(int &x_min, int &y_min, int &x_max, int &y_max) const;
+	};
+
+	/*!
+	 * \brief Columnar copy of the shapes of a structure.
+	 *
+	 * It is built by Structure::layers() and dropped whenever the structure
+	 * or one of its elements changes. References are not expanded.
+	 */
+	class LayerStore
+	{
+		std::vector<LayerShapes>    Layers;     //< Ordered by layer, then datatype.
+
+	public:
+		void build(Structure *structure);
+		void clear();
+
+		size_t size() const;
+		const LayerShapes& get(size_t index) const;
+		/*!
+		 * \return	nullptr if the structure has no shape on the layer.
+		 */
+		const LayerShapes* find(short layer, short data_type) const;
+	};
+}
+
+#endif
@@ -0,0 +1,248 @@
+/*
+ * This file is part of GDSII.
+ *
+ * libindex.cpp -- The source file which defines the structure index of
+ *                 GDSII files.
+ *
+ * Copyright (c) 2015 Kangpeng Shao <billowen035@gmail.com>
+ *
+ * GDSII is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at you option) any later version.
+ *
+ * GDSII is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABLILTY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GDSII. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#include <fstream>
+#include <sstream>
+#include "libindex.h"
+#include "gdsio.h"
+#include "mappedfile.h"
+#include "exceptions.h"
+
+namespace GDS
+{
+	static const int Index_version = 1;
+
+	StructureSpan::StructureSpan()
+	{
+		offset = 0;
+		length = 0;
+		boundaries = 0;
+		paths = 0;
+		texts = 0;
+		srefs = 0;
+		arefs = 0;
+		x_min = 1;
+		y_min = 1;
+		x_max = 0;
+		y_max = 0;
+	}
+
+	StructureSpan skipStructure(RecordReader &reader)
+	{
+		const Record &rec = reader.record();
+		StructureSpan span;
+		span.offset = reader.offset();
+		bool empty = true;
+		while (true)
+		{
+			if (!reader.next())
+				throw FormatError("unexpected end of file where ENDSTR are expected.");
+
+			bool finished = false;
+			switch (rec.record_type)
+			{
+			case ENDSTR:
+				finished = true;
+				break;
+			case STRNAME:
+				if (span.name.empty())
+					span.name = rec.getString();
+				break;
+			case BOUNDARY:
+				span.boundaries++;
+				break;
+			case PATH:
+				span.paths++;
+				break;
+			case TEXT:
+				span.texts++;
+				break;
+			case SREF:
+				span.srefs++;
+				break;
+			case AREF:
+				span.arefs++;
+				break;
+			case XY:
+				for (int i = 0; i + 8 <= rec.length(); i += 8)
+				{
+					int x = bytesToInteger(rec.data + i);
+					int y = bytesToInteger(rec.data + i + 4);
+					if (empty)
+					{
+						span.x_min = span.x_max = x;
+						span.y_min = span.y_max = y;
+						empty = false;
+						continue;
+					}
+					if (x < span.x_min) span.x_min = x;
+					if (x > span.x_max) span.x_max = x;
+					if (y < span.y_min) span.y_min = y;
+					if (y > span.y_max) span.y_max = y;
+				}
+				break;
+			default:
+				break;
+			}
+			if (finished)
+				break;
+		}
+		span.length = reader.offset() + rec.size - span.offset;
+		return span;
+	}
+
+	LibraryIndex::LibraryIndex()
+	{
+		File_size = -1;
+		File_time = -1;
+	}
+
+	void LibraryIndex::clear()
+	{
+		File_size = -1;
+		File_time = -1;
+		Spans.clear();
+	}
+
+	const std::vector<StructureSpan>& LibraryIndex::spans() const
+	{
+		return Spans;
+	}
+
+	void LibraryIndex::setSpans(const std::vector<StructureSpan> &spans, long long file_size, long long file_time)
+	{
+		Spans = spans;
+		File_size = file_size;
+		File_time = file_time;
+	}
+
+	bool LibraryIndex::build(std::string gds_path)
+	{
+		clear();
+		long long size, mtime;
+		if (!MappedFile::status(gds_path, size, mtime))
+			return false;
+		MappedFile file;
+		if (!file.open(gds_path))
+			return false;
+
+		RecordReader reader(file.data(), file.size());
+		const Record &rec = reader.record();
+		std::vector<StructureSpan> spans;
+		while (reader.next())
+		{
+			if (rec.record_type == BGNSTR)
+				spans.push_back(skipStructure(reader));
+			else if (rec.record_type == ENDLIB)
+				break;
+		}
+		setSpans(spans, size, mtime);
+		return true;
+	}
+
+	bool LibraryIndex::load(std::string index_path, std::string gds_path)
+	{
+		clear();
+		long long size, mtime;
+		if (!MappedFile::status(gds_path, size, mtime))
+			return false;
+
+		std::ifstream in(index_path.c_str());
+		if (!in.is_open())
+			return false;
+
+		std::string magic;
+		int version = 0;
+		long long index_size = -1, index_time = -1;
+		size_t count = 0;
+		in >> magic >> version >> index_size >> index_time >> count;
+		if (!in || magic != "GDSINDEX" || version != Index_version
+			|| index_size != size || index_time != mtime)
+			return false;
+		// The smallest structure is a BGNSTR, a STRNAME of two bytes and an
+		// ENDSTR, 38 bytes; a larger count cannot come from this file.
+		if (count > (unsigned long long)size / 38)
+			return false;
+
+		std::vector<StructureSpan> spans;
+		for (size_t i = 0; i < count; i++)
+		{
+			StructureSpan span;
+			in >> span.offset >> span.length
+				>> span.boundaries >> span.paths >> span.texts >> span.srefs >> span.arefs
+				>> span.x_min >> span.y_min >> span.x_max >> span.y_max;
+			// The name is the rest of the line after a single space.
+			in.get();
+			std::getline(in, span.name);
+			if (!in || span.offset < 0 || span.length < 4 || span.offset + span.length > size)
+				return false;
+			spans.push_back(span);
+		}
+		setSpans(spans, size, mtime);
+		return true;
+	}
+
+	bool LibraryIndex::check(const Byte *data, size_t size) const
+	{
+		for (const StructureSpan &span : Spans)
+		{
+			if (span.offset < 0 || span.length < 4 || (unsigned long long)(span.offset + span.length) > size)
+				return false;
+			const Byte *end = data + span.offset + span.length - 4;
+			if (end[0] != 0 || end[1] != 4 || end[2] != ENDSTR)
+				return false;
+			try
+			{
+				RecordReader reader(data + span.offset, (size_t)span.length, span.offset);
+				const Record &rec = reader.record();
+				if (!reader.next() || rec.record_type != BGNSTR)
+					return false;
+				if (!reader.next() || rec.record_type != STRNAME || rec.getString() != span.name)
+					return false;
+			}
+			catch (FormatError &)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool LibraryIndex::save(std::string index_path) const
+	{
+		std::ofstream out(index_path.c_str());
+		if (!out.is_open())
+			return false;
+
+		out << "GDSINDEX " << Index_version << " " << File_size << " " << File_time
+			<< " " << Spans.size() << "\n";
+		for (const StructureSpan &span : Spans)
+		{
+			out << span.offset << " " << span.length << " "
+				<< span.boundaries << " " << span.paths << " " << span.texts << " "
+				<< span.srefs << " " << span.arefs << " "
+				<< span.x_min << " " << span.y_min << " " << span.x_max << " " << span.y_max << " "
+				<< span.name << "\n";
+		}
+		return out.good();
+	}
+}
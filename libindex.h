@@ -0,0 +1,117 @@
+/*
+ * This file is part of GDSII.
+ *
+ * libindex.h -- The header file which declare the structure index of
+ *               GDSII files.
+ *
+ * Copyright (c) 2015 Kangpeng Shao <billowen035@gmail.com>
+ *
+ * GDSII is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at you option) any later version.
+ *
+ * GDSII is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABLILTY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GDSII. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef GDS_LIBINDEX_H
+#define GDS_LIBINDEX_H
+
+#include <string>
+#include <vector>
+#include "tags.h"
+
+namespace GDS
+{
+	class RecordReader;
+
+	/*!
+	 * \brief Location and summary of one BGNSTR .. ENDSTR block in a gdsii file.
+	 */
+	struct StructureSpan
+	{
+		std::string     name;
+		long long       offset;         //< File offset of the BGNSTR record.
+		long long       length;         //< Size up to and including ENDSTR.
+		int             boundaries;
+		int             paths;
+		int             texts;
+		int             srefs;
+		int             arefs;
+		/*
+		 * Extent of the XY records of the structure itself. Referenced
+		 * structures are not expanded. x_min > x_max if there is no XY.
+		 */
+		int             x_min, y_min, x_max, y_max;
+
+		StructureSpan();
+	};
+
+	/*!
+	 * \brief Skip the structure which begins at the current BGNSTR record.
+	 *
+	 * Only the record headers and the XY payloads are looked at. When the
+	 * call returns, the current record of the reader is the ENDSTR record.
+	 */
+	StructureSpan skipStructure(RecordReader &reader);
+
+	/*!
+	 * \brief Index of the structures in a gdsii file.
+	 *
+	 * The index can be saved as a sidecar file next to the gdsii file. It
+	 * records the size and the modification time of the gdsii file, so a
+	 * stale index is detected when it is loaded.
+	 *
+	 * Format of the sidecar file (text):
+	 *  GDSINDEX <version> <file size> <mtime> <number of structures>
+	 *  <offset> <length> <boundaries> <paths> <texts> <srefs> <arefs> <x_min> <y_min> <x_max> <y_max> <name>
+	 *  ...
+	 */
+	class LibraryIndex
+	{
+		long long                   File_size;
+		long long                   File_time;
+		std::vector<StructureSpan>  Spans;
+
+	public:
+		LibraryIndex();
+
+		/*!
+		 * Scan a gdsii file and index its structures.
+		 *
+		 * \return	false if the file can not be opened. The call will throw
+		 *			FormatError for a broken file.
+		 */
+		bool build(std::string gds_path);
+		/*!
+		 * Load a sidecar index.
+		 *
+		 * \return	false if the index is missing, broken or does not match the
+		 *			size and the modification time of the gdsii file.
+		 */
+		bool load(std::string index_path, std::string gds_path);
+		bool save(std::string index_path) const;
+		/*!
+		 * Check the spans against the gdsii file they index. Size and time
+		 * of the file can match although its contents changed, so every span
+		 * has to begin with the BGNSTR and STRNAME records of its structure
+		 * and end with ENDSTR.
+		 *
+		 * \param [in] data		The contents of the gdsii file.
+		 * \param [in] size		Size of the contents in bytes.
+		 */
+		bool check(const Byte *data, size_t size) const;
+
+		void clear();
+		const std::vector<StructureSpan>& spans() const;
+		void setSpans(const std::vector<StructureSpan> &spans, long long file_size, long long file_time);
+	};
+}
+
+#endif
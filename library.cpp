@@ -24,7 +24,13 @@
 #include "exceptions.h"
 #include "tags.h"
 #include "gdsio.h"
+#include "mappedfile.h"
+#include "parallel.h"
+#include "hierarchy.h"
+#include "stringtable.h"
 #include <sstream>
+#include <memory>
+#include <algorithm>
 #include <ctime>
 #include "log.h"
 #include "elements.h"
@@ -35,6 +41,7 @@ namespace GDS {
 
 	Library::Library()
 	{
+		Link_epoch = 1;
 		init();
 	}
 
@@ -89,88 +96,468 @@ namespace GDS {
 			}
 		}
 		Contents.clear();
+		Name_index.clear();
+		Targets.clear();
+		Referrers.clear();
+		Holes = 0;
+		Link_epoch++;
+		Index.clear();
+		Mapping.close();
 	}
 
 	size_t Library::size()
 	{
-		for (int i = (int)Contents.size() - 1; i >= 0; i--)
+		compact();
+		return Contents.size();
+	}
+
+	void Library::compact()
+	{
+		if (Holes == 0)
+			return;
+		size_t n = 0;
+		for (size_t i = 0; i < Contents.size(); i++)
 		{
-			if (Contents[i] == nullptr)
-				Contents.erase(Contents.begin() + i);
+			if (Contents[i] != nullptr)
+				Contents[n++] = Contents[i];
 		}
-		return Contents.size();
+		Contents.resize(n);
+		Holes = 0;
+		reindex();
 	}
 
-	Structure* Library::get(int index)
+	void Library::reindex()
 	{
-		if (index < 0 || (size_t)index >= Contents.size())
-			return nullptr;
-		return Contents[index];
+		Name_index.clear();
+		Name_index.reserve(Contents.size());
+		for (size_t i = 0; i < Contents.size(); i++)
+		{
+			if (Contents[i] != nullptr)
+				Name_index.insert(std::make_pair(Contents[i]->nameId(), i));
+		}
 	}
 
-	Structure* Library::add(std::string name)
+	void Library::append(Structure *node)
 	{
-		bool existed = false;
-		for (Structure* e : Contents)
+		// The first of several structures with the same name wins, as it
+		// did for the linear search.
+		Name_index.insert(std::make_pair(node->nameId(), Contents.size()));
+		Contents.push_back(node);
+		node->setLibrary(this);
+		node->touch();
+		Structure* &target = Targets[node->nameId()];
+		if (target == nullptr)
 		{
-			if (e == nullptr)
+			target = node;
+			Link_epoch++;
+		}
+	}
+
+	Structure* const* Library::slot(StringId name)
+	{
+		return &Targets[name];
+	}
+
+	// A structure stays listed for a name when its references to the name
+	// are edited away, which only costs a needless invalidation.
+	void Library::addReferrer(StringId name, Structure *node)
+	{
+		if (node != nullptr && node->Referenced.insert(name).second)
+			Referrers[name].push_back(node);
+	}
+
+	void Library::removeReferrer(Structure *node)
+	{
+		for (StringId name : node->Referenced)
+		{
+			auto it = Referrers.find(name);
+			if (it == Referrers.end())
 				continue;
-			if (e->name() == name)
+			std::vector<Structure*> &nodes = it->second;
+			nodes.erase(std::remove(nodes.begin(), nodes.end(), node), nodes.end());
+			if (nodes.empty())
+				Referrers.erase(it);
+		}
+		node->Referenced.clear();
+	}
+
+	void Library::link()
+	{
+		for (Structure *node : Contents)
+		{
+			if (node != nullptr)
+				link(node);
+		}
+	}
+
+	void Library::link(Structure *node)
+	{
+		// A structure which is not loaded yet links itself when it is.
+		if (!node->isLoaded())
+			return;
+		struct Linker : ElementVisitor
+		{
+			Library     *Owner;
+			Structure   *Node;
+
+			void sref(SRef &e)
 			{
-				existed = true;
-				break;
+				e.setTarget(Owner->slot(e.structNameId()));
+				Owner->addReferrer(e.structNameId(), Node);
+			}
+
+			void aref(ARef &e)
+			{
+				e.setTarget(Owner->slot(e.structNameId()));
+				Owner->addReferrer(e.structNameId(), Node);
 			}
+		};
+		Linker linker;
+		linker.Owner = this;
+		linker.Node = node;
+		node->visit(linker);
+	}
+
+	void Library::link(Element *e)
+	{
+		if (e == nullptr)
+			return;
+		if (e->tag() == SREF)
+		{
+			SRef *ref = static_cast<SRef*>(e);
+			ref->setTarget(slot(ref->structNameId()));
+			addReferrer(ref->structNameId(), e->parent());
+		}
+		else if (e->tag() == AREF)
+		{
+			ARef *ref = static_cast<ARef*>(e);
+			ref->setTarget(slot(ref->structNameId()));
+			addReferrer(ref->structNameId(), e->parent());
 		}
-		if (existed)
+	}
+
+	Structure* Library::get(int index)
+	{
+		compact();
+		if (index < 0 || (size_t)index >= Contents.size())
+			return nullptr;
+		if (Contents[index] != nullptr)
+			Contents[index]->load();
+		return Contents[index];
+	}
+
+	Structure* Library::add(std::string name)
+	{
+		if (Name_index.find(internString(name)) != Name_index.end())
 			return nullptr;
 
 		Structure* new_item = new Structure(name);
-		Contents.push_back(new_item);
+		append(new_item);
 		return new_item;
 	}
 
 	Structure* Library::get(std::string name)
 	{
-		for (Structure* e : Contents)
+		StringId id;
+		if (!StringTable::getInstance()->find(name, id))
+			return nullptr;
+		return find(id);
+	}
+
+	Structure* Library::find(StringId name)
+	{
+		auto it = Name_index.find(name);
+		if (it == Name_index.end())
+			return nullptr;
+		Structure* e = Contents[it->second];
+		e->load();
+		return e;
+	}
+
+	void Library::del(std::string name)
+	{
+		StringId id;
+		if (!StringTable::getInstance()->find(name, id))
+			return;
+		auto it = Name_index.find(id);
+		if (it == Name_index.end())
+			return;
+
+		// Leave a hole, so the positions of the other structures stay valid
+		// for the index. The holes are squeezed out by the next size() or
+		// get(int).
+		size_t index = it->second;
+		Name_index.erase(it);
+		Contents[index]->touch();
+		removeReferrer(Contents[index]);
+		delete Contents[index];
+		Contents[index] = nullptr;
+		Holes++;
+
+		// Another structure of the same name, if any, takes over the name
+		// and the references to it.
+		Structure *next = nullptr;
+		for (size_t i = 0; i < Contents.size(); i++)
 		{
-			if (e == nullptr)
-				continue;
-			if (e->name() == name)
+			if (Contents[i] != nullptr && Contents[i]->nameId() == id)
 			{
-				return e;
+				Name_index.insert(std::make_pair(id, i));
+				next = Contents[i];
+				break;
 			}
 		}
-		return nullptr;
+		Targets[id] = next;
+		Link_epoch++;
 	}
 
-	void Library::del(std::string name)
+	size_t Library::merge(const std::vector<Library*> &sources, int threads)
 	{
-		Structure* node = get(name);
-		if (node == nullptr)
-			return;
-
-		for (size_t i = 0; i < size(); i++)
+		compact();
+		Hierarchy(this).computeHashes(threads);
+		// The first of several equal structures is kept. Equal hashes only
+		// pick the candidates.
+		std::unordered_multimap<unsigned long long, Structure*> kept;
+		for (Structure *node : Contents)
+			kept.insert(std::make_pair(node->hash(), node));
+
+		size_t dropped = 0;
+		for (Library *source : sources)
 		{
-			Structure* node = Contents[i];
-			assert(node != nullptr);
-			if (node == nullptr)
+			if (source == nullptr || source == this)
 				continue;
-			if (node->name() == name)
+			source->compact();
+			Hierarchy(source).computeHashes(threads);
+			std::vector<Structure*> taken;
+			taken.swap(source->Contents);
+
+			// Sort out the duplicates before anything moves, since moving
+			// drops the cached hashes.
+			StructureComparer same;
+			std::vector<Structure*> equal(taken.size(), nullptr);     // Structure kept for a duplicate.
+			for (size_t i = 0; i < taken.size(); i++)
+			{
+				Structure *node = taken[i];
+				unsigned long long hash = node->hash();
+				auto range = kept.equal_range(hash);
+				for (auto it = range.first; it != range.second && equal[i] == nullptr; ++it)
+				{
+					if (same.equal(it->second, node))
+						equal[i] = it->second;
+				}
+				if (equal[i] == nullptr)
+					kept.insert(std::make_pair(hash, node));
+			}
+
+			std::unordered_map<StringId, StringId> names;     // Name in the source to name here.
+			std::vector<Structure*> moved, duplicates;
+			for (size_t i = 0; i < taken.size(); i++)
+			{
+				Structure *node = taken[i];
+				if (equal[i] != nullptr)
+				{
+					duplicates.push_back(node);
+					continue;
+				}
+				StringId name = node->nameId();
+				if (Name_index.find(name) != Name_index.end())
+				{
+					std::string base = node->name();
+					for (size_t n = 1; ; n++)
+					{
+						std::string candidate = base + "_" + std::to_string(n);
+						StringId id;
+						if (!StringTable::getInstance()->find(candidate, id) || Name_index.find(id) == Name_index.end())
+						{
+							node->setName(candidate);
+							break;
+						}
+					}
+				}
+				names.insert(std::make_pair(name, node->nameId()));
+				append(node);
+				moved.push_back(node);
+			}
+			// A duplicate may stand for a structure of its own source,
+			// which has its final name only now.
+			for (size_t i = 0; i < taken.size(); i++)
+			{
+				if (equal[i] != nullptr)
+					names.insert(std::make_pair(taken[i]->nameId(), equal[i]->nameId()));
+			}
+
+			// Point the references at the names and slots of this library.
+			struct Renamer : ElementVisitor
+			{
+				const std::unordered_map<StringId, StringId>    *Names;
+
+				void sref(SRef &e)
+				{
+					auto it = Names->find(e.structNameId());
+					if (it != Names->end() && it->second != e.structNameId())
+						e.setStructName(internedString(it->second));
+				}
+
+				void aref(ARef &e)
+				{
+					auto it = Names->find(e.structNameId());
+					if (it != Names->end() && it->second != e.structNameId())
+						e.setStructName(internedString(it->second));
+				}
+			};
+			Renamer renamer;
+			renamer.Names = &names;
+			for (Structure *node : moved)
 			{
+				node->visit(renamer);
+				link(node);
+			}
+			for (Structure *node : duplicates)
 				delete node;
-				Contents.erase(Contents.begin() + i);
-				break;
+			dropped += duplicates.size();
+			source->init();
+		}
+		return dropped;
+	}
+
+	bool Library::merge(const std::vector<std::string> &paths, int threads)
+	{
+		if (threads <= 0)
+			threads = defaultThreads();
+		for (size_t first = 0; first < paths.size(); first += threads)
+		{
+			size_t count = std::min(paths.size() - first, (size_t)threads);
+			std::vector<std::unique_ptr<Library> > batch(count);
+			std::vector<char> mapped(count, 0);
+			// Every structure gets an arena of its own, so a duplicate frees
+			// its memory when it is dropped.
+			parallelFor(count, threads, [&](size_t i)
+			{
+				batch[i].reset(new Library());
+				mapped[i] = batch[i]->readParallel(paths[first + i], 1);
+			});
+			std::vector<Library*> sources;
+			for (size_t i = 0; i < count; i++)
+			{
+				if (!mapped[i])
+				{
+					merge(sources, threads);
+					return false;
+				}
+				sources.push_back(batch[i].get());
 			}
+			merge(sources, threads);
 		}
+		return true;
 	}
 
 	bool Library::read(std::ifstream &in)
+	{
+		RecordReader reader(in);
+		return read(reader);
+	}
+
+	bool Library::readMapped(std::string path)
+	{
+		MappedFile file;
+		if (!file.open(path))
+			return false;
+		RecordReader reader(file.data(), file.size());
+		return read(reader);
+	}
+
+	bool Library::readParallel(std::string path, int threads)
+	{
+		MappedFile file;
+		if (!file.open(path))
+			return false;
+
+		// Phase 1: read the library records and locate every structure.
+		init();
+		RecordReader reader(file.data(), file.size());
+		std::vector<StructureSpan> spans;
+		readContents(reader, &spans, false);
+
+		// Phase 2: parse the structures concurrently. The nodes are created
+		// up front, so Contents keeps the order of the file.
+		size_t first = Contents.size();
+		for (size_t i = 0; i < spans.size(); i++)
+		{
+			append(new Structure(spans[i].name));
+		}
+		const Byte *data = file.data();
+		parallelFor(spans.size(), threads, [&](size_t i)
+		{
+			const StructureSpan &span = spans[i];
+			RecordReader sub(data + span.offset, (size_t)span.length, span.offset);
+			sub.next();
+			// The elements take about twice the size of their records.
+			Contents[first + i]->arena()->reserve((size_t)span.length * 2);
+			Contents[first + i]->read(sub);
+		});
+		reindex();
+		link();
+		return true;
+	}
+
+	bool Library::read(RecordReader &reader)
+	{
+		init();
+		return readContents(reader, nullptr, false);
+	}
+
+	bool Library::openLazy(std::string path, std::string index_path)
 	{
 		init();
+		if (!Mapping.open(path))
+			return false;
+		if (index_path.empty())
+			index_path = path + ".idx";
+
+		RecordReader reader(Mapping.data(), Mapping.size());
+		if (Index.load(index_path, path) && Index.check(Mapping.data(), Mapping.size()))
+		{
+			readContents(reader, nullptr, true);
+		}
+		else
+		{
+			std::vector<StructureSpan> spans;
+			readContents(reader, &spans, false);
+			long long size, mtime;
+			if (MappedFile::status(path, size, mtime))
+			{
+				Index.setSpans(spans, size, mtime);
+				Index.save(index_path);
+			}
+			else
+			{
+				Index.setSpans(spans, (long long)Mapping.size(), -1);
+			}
+		}
+
+		for (const StructureSpan &span : Index.spans())
+		{
+			Structure *node = new Structure(span.name);
+			node->setSource(Mapping.data() + span.offset, (size_t)span.length, span.offset);
+			append(node);
+		}
+		return true;
+	}
+
+	const LibraryIndex& Library::index() const
+	{
+		return Index;
+	}
+
+	bool Library::readContents(RecordReader &reader, std::vector<StructureSpan> *spans, bool header_only)
+	{
+		const Record &rec = reader.record();
+		Arena *arena = nullptr;     // Shared by the structures read here.
 		// read HEADER
-		short record_size = readShort(in);
-		Byte record_type = readByte(in);
-		Byte data_type = readByte(in);
+		if (!reader.next())
+			throw FormatError("unexpected end of file where HEADER are expected.");
+		int record_size = rec.size;
+		Byte record_type = rec.record_type;
+		Byte data_type = rec.data_type;
 		if (record_type != HEADER)
 		{
 			std::stringstream ss;
@@ -189,7 +576,7 @@ namespace GDS {
 			std::string msg = ss.str();
 			throw FormatError(msg);
 		}
-		Version = readShort(in);
+		Version = rec.getShort();
 
 #ifdef _DEBUG_LOG
         LogIO* log = LogIO::getInstance();
@@ -199,9 +586,11 @@ namespace GDS {
 #endif
 
 		// read BGNLIB
-		record_size = readShort(in);
-		record_type = readByte(in);
-		data_type = readByte(in);
+		if (!reader.next())
+			throw FormatError("unexpected end of file where BGNLIB are expected.");
+		record_size = rec.size;
+		record_type = rec.record_type;
+		data_type = rec.data_type;
 		if (record_type != BGNLIB)
 		{
 			std::stringstream ss;
@@ -220,18 +609,18 @@ namespace GDS {
 			std::string msg = ss.str();
 			throw FormatError(msg);
 		}
-		Mod_year = readShort(in);
-		Mod_month = readShort(in);
-		Mod_day = readShort(in);
-		Mod_hour = readShort(in);
-		Mod_minute = readShort(in);
-		Mod_second = readShort(in);
-		Acc_year = readShort(in);
-		Acc_month = readShort(in);
-		Acc_day = readShort(in);
-		Acc_hour = readShort(in);
-		Acc_minute = readShort(in);
-		Acc_second = readShort(in);
+		Mod_year = rec.getShort(0);
+		Mod_month = rec.getShort(1);
+		Mod_day = rec.getShort(2);
+		Mod_hour = rec.getShort(3);
+		Mod_minute = rec.getShort(4);
+		Mod_second = rec.getShort(5);
+		Acc_year = rec.getShort(6);
+		Acc_month = rec.getShort(7);
+		Acc_day = rec.getShort(8);
+		Acc_hour = rec.getShort(9);
+		Acc_minute = rec.getShort(10);
+		Acc_second = rec.getShort(11);
 
 #ifdef _DEBUG_LOG
         {
@@ -246,9 +635,11 @@ namespace GDS {
 
 		while (1)
 		{
-			record_size = readShort(in);
-			record_type = readByte(in);
-			data_type = readByte(in);
+			if (!reader.next())
+				throw FormatError("unexpected end of file where ENDLIB are expected.");
+			record_size = rec.size;
+			record_type = rec.record_type;
+			data_type = rec.data_type;
 
 
 			bool finished = false;
@@ -274,7 +665,7 @@ namespace GDS {
 					std::string msg = ss.str();
 					throw FormatError(msg);
 				}
-				Lib_name = readString(in, record_size - 4);
+				Lib_name = rec.getString();
 #ifdef _DEBUG_LOG
                 {
                     std::stringstream ss;
@@ -294,8 +685,8 @@ namespace GDS {
 					std::string msg = ss.str();
 					throw FormatError(msg);
 				}
-				DBUnit_in_userunit = readDouble(in);
-				DBUnit_in_meter = readDouble(in);
+				DBUnit_in_userunit = rec.getDouble(0);
+				DBUnit_in_meter = rec.getDouble(1);
 #ifdef _DEBUG_LOG
                 {
                     std::stringstream ss;
@@ -325,9 +716,19 @@ namespace GDS {
                     log->write(ss.str());
                 }
 #endif
+				if (header_only)
+					return true;
+				if (spans != nullptr)
+				{
+					spans->push_back(skipStructure(reader));
+					break;
+				}
+				if (arena == nullptr)
+					arena = new Arena();
 				Structure *node = new Structure();
-				node->read(in);
-				Contents.push_back(node);
+				node->setArena(arena);
+				node->read(reader);
+				append(node);
 				break;
 			}
 			default:
@@ -337,60 +738,41 @@ namespace GDS {
 				break;
 		}
 
+		if (arena != nullptr)
+			arena->release();
+		link();
 		return true;
 	}
 
 	bool Library::write(std::ofstream &out)
 	{
-		int record_size;
-
-		record_size = 6;
-		writeShort(out, record_size);
-		writeByte(out, HEADER);
-		writeByte(out, Integer_2);
-		writeShort(out, Version);
-
-		record_size = 28;
-		writeShort(out, record_size);
-		writeByte(out, BGNLIB);
-		writeByte(out, Integer_2);
-		writeShort(out, Mod_year);
-		writeShort(out, Mod_month);
-		writeShort(out, Mod_day);
-		writeShort(out, Mod_hour);
-		writeShort(out, Mod_minute);
-		writeShort(out, Mod_second);
-		writeShort(out, Acc_year);
-		writeShort(out, Acc_month);
-		writeShort(out, Acc_day);
-		writeShort(out, Acc_hour);
-		writeShort(out, Acc_minute);
-		writeShort(out, Acc_second);
-
-		record_size = 4 + Lib_name.size();
-		if (record_size % 2 != 0)
-			record_size += 1;
-		writeShort(out, record_size);
-		writeByte(out, LIBNAME);
-		writeByte(out, String);
-		writeString(out, Lib_name);
-
-		record_size = 20;
-		writeShort(out, record_size);
-		writeByte(out, UNITS);
-		writeByte(out, Real_8);
-		writeDouble(out, DBUnit_in_userunit);
-		writeDouble(out, DBUnit_in_meter);
+		RecordWriter writer(out);
+		write(writer);
+		writer.flush();
+		return true;
+	}
+
+	bool Library::write(RecordWriter &writer)
+	{
+		writer.writeShort(HEADER, Version);
+
+		short dates[12] = {
+			Mod_year, Mod_month, Mod_day, Mod_hour, Mod_minute, Mod_second,
+			Acc_year, Acc_month, Acc_day, Acc_hour, Acc_minute, Acc_second
+		};
+		writer.writeShorts(BGNLIB, dates, 12);
+		writer.writeString(LIBNAME, Lib_name);
+
+		double units[2] = { DBUnit_in_userunit, DBUnit_in_meter };
+		writer.writeDoubles(UNITS, units, 2);
 
 		for (Structure *e : Contents)
 		{
-			e->write(out);
+			if (e != nullptr)
+				e->write(writer);
 		}
 
-		record_size = 4;
-		writeShort(out, record_size);
-		writeByte(out, ENDLIB);
-		writeByte(out, NoData);
+		writer.writeRecord(ENDLIB);
 
 		return true;
 	}
@@ -416,7 +798,8 @@ namespace GDS {
 
 		for (auto e : Contents)
 		{
-			e->printASCII(out);
+			if (e != nullptr)
+				e->printASCII(out);
 		}
 		out << "ENDLIB";
 		return true;
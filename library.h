@@ -24,8 +24,12 @@
 
 #include <string>
 #include <vector>
+#include <unordered_map>
 #include <fstream>
 #include "structures.h"
+#include "gdsio.h"
+#include "libindex.h"
+#include "mappedfile.h"
 
 namespace GDS {
 
@@ -48,9 +52,35 @@ namespace GDS {
 		double          DBUnit_in_userunit;
 
 		std::vector<Structure*> Contents;
+		std::unordered_map<StringId, size_t> Name_index;       //< Interned name to position in Contents.
+		std::unordered_map<StringId, Structure*> Targets;      //< Slots the references point to, by name.
+		std::unordered_map<StringId, std::vector<Structure*> > Referrers;  //< Loaded structures which reference a name.
+		size_t          Holes;          //< Deleted entries left as nullptr in Contents.
+		unsigned long   Link_epoch;     //< Bumped whenever a slot changes its structure.
 
-		Library();
+		MappedFile      Mapping;        //< Backs the structures of a lazy library.
+		LibraryIndex    Index;
+
+		Library(const Library&);
+		Library& operator=(const Library&);
+
+		friend class Structure;
+
+		bool readContents(RecordReader &reader, std::vector<StructureSpan> *spans, bool header_only);
+		void append(Structure *node);
+		void addReferrer(StringId name, Structure *node);
+		void removeReferrer(Structure *node);
+		void compact();
+		void reindex();
 	public:
+		/*!
+		 * \brief An empty library.
+		 *
+		 * Besides the shared instance of getInstance(), any number of
+		 * libraries can be open at once, e.g. to compare two of them. Their
+		 * structures link their references within their own library.
+		 */
+		Library();
 		~Library();
         
         static Library* getInstance();
@@ -60,6 +90,33 @@ namespace GDS {
 		size_t size();
 		Structure* get(int index);
 		Structure* get(std::string name);
+		/*!
+		 * \brief Find a structure by its interned name.
+		 *
+		 * \param [in] name		Id of the name in the StringTable.
+		 *
+		 * \return	The structure, or nullptr if the library has none by that name.
+		 */
+		Structure* find(StringId name);
+		/*!
+		 * \brief The slot which holds the structure of the given name.
+		 *
+		 * The slot is created empty if the name is unknown. Its address stays
+		 * valid until the library is re-initialized, and its value follows
+		 * add() and del().
+		 */
+		Structure* const* slot(StringId name);
+		/*!
+		 * \brief Resolve the SREF and AREF elements of all loaded structures.
+		 *
+		 * It is called by the read functions, and by Structure::add(),
+		 * Structure::set() and Structure::load() for the elements they touch,
+		 * so it only needs to be called explicitly after editing the
+		 * elements of a structure in place.
+		 */
+		void link();
+		void link(Structure *node);
+		void link(Element *e);
 		/*!
 		 * Add a new structure into library. If there is a structure existed in library which
 		 * have the same name, it will cause the failure of process.
@@ -71,11 +128,51 @@ namespace GDS {
 		 */
 		Structure* add(std::string name);
 		/*!
-		 * Delete a structure in the library.
+		 * Delete a structure in the library. The structures after it move up
+		 * by one position in the order of the library. If another structure
+		 * has the same name, the references to the name move to it.
 		 *
 		 * \param [in] name			Name of structure.
 		 */
 		void del(std::string name);
+		/*!
+		 * \brief Move the structures of other libraries into this one.
+		 *
+		 * The sources are taken in order, each in its own order, after the
+		 * structures already here. A structure equal to one already here is
+		 * dropped, and the references to it go to that one; candidates are
+		 * found by Structure::hash() and confirmed by a StructureComparer. A
+		 * structure whose name is taken by a different one is renamed to the
+		 * first free name + "_1", name + "_2", ... The references of the
+		 * moved structures are rewritten to the names they end up with, so
+		 * the result only depends on the order of the sources.
+		 *
+		 * The sources are left empty. Their units are not converted.
+		 *
+		 * \param [in] sources		Libraries to empty into this one.
+		 * \param [in] threads		Number of threads to hash the structures
+		 *							with, 0 for defaultThreads().
+		 *
+		 * \return	The number of structures dropped as duplicates.
+		 */
+		size_t merge(const std::vector<Library*> &sources, int threads = 0);
+		/*!
+		 * \brief Read gdsii files and merge them into this library.
+		 *
+		 * The files are read on several threads, a batch of one file per
+		 * thread at a time, and each batch is merged as merge() does before
+		 * the next is read. Every structure read here has an arena of its
+		 * own, so a duplicate frees its memory when it is dropped, and the
+		 * memory held stays near the merged library plus one batch. The
+		 * call will throw some exceptions.
+		 *
+		 * \param [in] paths		Paths of the gdsii files, in the order to merge.
+		 * \param [in] threads		Number of threads, 0 for defaultThreads().
+		 *
+		 * \return	false if a file can not be mapped; the files before it
+		 *			are merged.
+		 */
+		bool merge(const std::vector<std::string> &paths, int threads = 0);
 
 
 		/*!
@@ -86,6 +183,57 @@ namespace GDS {
 		 * \return
 		 */
 		bool read(std::ifstream &in);
+		/*!
+		 * \brief Read gdsii data from a record reader.
+		 *
+		 * The call will throw some exceptions.
+		 * \param reader
+		 * \return
+		 */
+		bool read(RecordReader &reader);
+		/*!
+		 * \brief Read gdsii data from a file through a read-only memory mapping.
+		 *
+		 * Records are parsed in place out of the mapping, so the file is never
+		 * copied through a stream buffer. The call will throw some exceptions.
+		 *
+		 * \param [in] path		Path of the gdsii file.
+		 *
+		 * \return	false if the file can not be mapped.
+		 */
+		bool readMapped(std::string path);
+		/*!
+		 * \brief Read gdsii data from a file with several threads.
+		 *
+		 * A first pass over the memory-mapped file locates every structure,
+		 * then the structures are parsed concurrently and kept in file order.
+		 * The call will throw some exceptions.
+		 *
+		 * \param [in] path		Path of the gdsii file.
+		 * \param [in] threads	Number of threads, 0 for one per hardware thread.
+		 *
+		 * \return	false if the file can not be mapped.
+		 */
+		bool readParallel(std::string path, int threads = 0);
+		/*!
+		 * \brief Open a gdsii file without parsing its structures.
+		 *
+		 * The file is mapped and only the library records are read. Every
+		 * structure is parsed the first time its contents are accessed, e.g.
+		 * through get(). The positions of the structures come from a sidecar
+		 * index, which is built and saved when it is missing or does not match
+		 * the file. The mapping stays open until the library is re-initialized.
+		 *
+		 * \param [in] path			Path of the gdsii file.
+		 * \param [in] index_path	Path of the index, path + ".idx" if empty.
+		 *
+		 * \return	false if the file can not be mapped.
+		 */
+		bool openLazy(std::string path, std::string index_path = "");
+		/*!
+		 * The structure index of a library opened by openLazy().
+		 */
+		const LibraryIndex& index() const;
 		/*!
 		 * \brief Write gdsii data to file stream.
 		 *
@@ -94,6 +242,13 @@ namespace GDS {
 		 * \return
 		 */
 		bool write(std::ofstream &out);
+		/*!
+		 * \brief Write gdsii data to a record writer.
+		 *
+		 * \param writer
+		 * \return
+		 */
+		bool write(RecordWriter &writer);
 		bool printASCII(std::ofstream &out);
 	};
 }
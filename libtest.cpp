@@ -0,0 +1,436 @@
+/*
+ * This file is part of GDSII.
+ *
+ * libtest.cpp -- Tests of the ways to read and merge libraries, and of
+ *                the data cached by their structures.
+ *
+ * Copyright (c) 2015 Kangpeng Shao <billowen035@gmail.com>
+ *
+ * GDSII is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at you option) any later version.
+ *
+ * GDSII is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABLILTY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GDSII. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "library.h"
+#include "structures.h"
+#include "boundary.h"
+#include "path.h"
+#include "text.h"
+#include "sref.h"
+#include "aref.h"
+#include "mappedfile.h"
+
+using namespace GDS;
+
+static int Failures = 0;
+
+static void check(bool ok, const std::string &what)
+{
+    if (!ok)
+    {
+        Failures++;
+        std::cout << "FAIL " << what << std::endl;
+    }
+}
+
+/*
+ * A small generator of its own, so that the library is the same everywhere.
+ **/
+static unsigned int Seed = 7;
+
+static int random(int n)
+{
+    Seed = Seed * 1103515245 + 12345;
+    return (int)((Seed >> 16) % (unsigned int)n);
+}
+
+/*
+ * Cells of random boundaries, paths and texts, each referencing some of
+ * the cells before it.
+ **/
+static void generate(Library &lib, int cells, int shapes)
+{
+    for (int c = 0; c < cells; c++)
+    {
+        Structure *s = lib.add("cell_" + std::to_string(c));
+        for (int k = 0; k < shapes; k++)
+        {
+            int kind = random(10);
+            if (kind < 6)
+            {
+                Boundary *b = new Boundary(s);
+                b->setLayer(random(5));
+                b->setDataType(random(2));
+                int x0 = random(100000) - 50000, y0 = random(100000) - 50000;
+                int w = 1 + random(1000), h = 1 + random(1000);
+                std::vector<int> x = {x0, x0 + w, x0 + w, x0, x0};
+                std::vector<int> y = {y0, y0, y0 + h, y0 + h, y0};
+                b->setXY(x, y);
+                s->add(b);
+            }
+            else if (kind < 8)
+            {
+                Path *p = new Path(s);
+                p->setLayer(random(5));
+                p->setWidth(10 + random(100));
+                p->setPathType(random(3));
+                std::vector<int> x, y;
+                int n = 2 + random(5);
+                for (int i = 0; i < n; i++)
+                {
+                    x.push_back(random(10000));
+                    y.push_back(-random(10000));
+                }
+                p->setXY(x, y);
+                s->add(p);
+            }
+            else if (kind < 9)
+            {
+                Text *t = new Text(s);
+                t->setLayer(random(5));
+                t->setXY(random(1000), random(1000));
+                t->setString("label" + std::to_string(random(1000)));
+                s->add(t);
+            }
+            else if (c > 0)
+            {
+                std::string target = "cell_" + std::to_string(random(c));
+                if (random(2))
+                {
+                    SRef *r = new SRef(s);
+                    r->setStructName(target);
+                    r->setXY(random(5000), random(5000));
+                    r->setAngle(random(4) * 90.0);
+                    s->add(r);
+                }
+                else
+                {
+                    ARef *r = new ARef(s);
+                    r->setStructName(target);
+                    r->setRowCol(1 + random(4), 1 + random(4));
+                    int x0 = random(5000), y0 = random(5000);
+                    std::vector<int> x = {x0, x0 + 4000, x0}, y = {y0, y0, y0 + 3000};
+                    r->setXY(x, y);
+                    s->add(r);
+                }
+            }
+        }
+    }
+}
+
+static bool sameBox(const Box &a, const Box &b)
+{
+    return a.x_min == b.x_min && a.y_min == b.y_min && a.x_max == b.x_max && a.y_max == b.y_max;
+}
+
+/*
+ * Same structures in the same order, with the same contents.
+ **/
+static void compare(Library &expected, Library &actual, const std::string &how)
+{
+    check(expected.size() == actual.size(), how + ": number of structures");
+    for (size_t i = 0; i < expected.size() && i < actual.size(); i++)
+    {
+        Structure *a = expected.get((int)i), *b = actual.get((int)i);
+        std::string what = how + ": " + a->name();
+        check(a->name() == b->name(), what + " name");
+        check(a->size() == b->size(), what + " size");
+        check(a->hash() == b->hash(), what + " hash");
+        check(sameBox(a->bbox(), b->bbox()), what + " bbox");
+    }
+}
+
+static const char *Path_name = "libtest.gds";
+static const char *Index_name = "libtest.gds.idx";
+
+static void testRead()
+{
+    Library generated;
+    generate(generated, 60, 150);
+    {
+        std::ofstream out(Path_name, std::ios::binary);
+        generated.write(out);
+    }
+    std::remove(Index_name);
+
+    Library streamed;
+    std::ifstream in(Path_name, std::ios::binary);
+    check(streamed.read(in), "read");
+    compare(generated, streamed, "read");
+
+    Library mapped;
+    check(mapped.readMapped(Path_name), "readMapped");
+    compare(streamed, mapped, "readMapped");
+
+    for (int threads = 1; threads <= 4; threads++)
+    {
+        Library parallel;
+        check(parallel.readParallel(Path_name, threads), "readParallel");
+        compare(streamed, parallel, "readParallel with " + std::to_string(threads) + " threads");
+    }
+
+    // The first open builds the index, the second uses it.
+    Library lazy;
+    check(lazy.openLazy(Path_name), "openLazy");
+    compare(streamed, lazy, "openLazy");
+    check(lazy.index().spans().size() == streamed.size(), "index size");
+    Library indexed;
+    check(indexed.openLazy(Path_name), "openLazy with index");
+    compare(streamed, indexed, "openLazy with index");
+}
+
+/*
+ * An index which matches the file but not its contents is rebuilt.
+ **/
+static void testBadIndex()
+{
+    long long size, mtime;
+    check(MappedFile::status(Path_name, size, mtime), "status");
+    Library streamed;
+    std::ifstream in(Path_name, std::ios::binary);
+    streamed.read(in);
+
+    const char *counts[] = {"18446744073709551615", "1000000000000", "1"};
+    for (const char *count : counts)
+    {
+        {
+            std::ofstream out(Index_name);
+            out << "GDSINDEX 1 " << size << " " << mtime << " " << count << "\n";
+        }
+        Library lazy;
+        check(lazy.openLazy(Path_name), std::string("openLazy with count ") + count);
+        compare(streamed, lazy, std::string("openLazy with count ") + count);
+    }
+    std::remove(Index_name);
+}
+
+/*
+ * Warm the cached boxes and hashes of every structure.
+ **/
+static void warm(Library &lib)
+{
+    for (size_t i = 0; i < lib.size(); i++)
+    {
+        lib.get((int)i)->bbox();
+        lib.get((int)i)->hash();
+    }
+}
+
+/*
+ * The cached boxes and hashes of an edited library, against a fresh read
+ * of it.
+ **/
+static void compareReread(Library &lib, const std::string &how)
+{
+    const char *path = "libtest_edit.gds";
+    {
+        std::ofstream out(path, std::ios::binary);
+        lib.write(out);
+    }
+    Library fresh;
+    check(fresh.readMapped(path), how + ": readMapped");
+    compare(fresh, lib, how);
+    std::remove(path);
+}
+
+/*
+ * Edits reach the cached data of every structure above them.
+ **/
+static void testCaches()
+{
+    Library lib;
+    generate(lib, 40, 60);
+    warm(lib);
+    for (int round = 0; round < 40; round++)
+    {
+        Structure *s = lib.get(random((int)lib.size()));
+        for (size_t k = 0; k < s->size(); k++)
+        {
+            Element *e = s->get((int)k);
+            if (e->tag() != BOUNDARY)
+                continue;
+            int x0 = random(400000) - 200000, y0 = random(400000) - 200000;
+            std::vector<int> x = {x0, x0 + 10, x0 + 10, x0, x0};
+            std::vector<int> y = {y0, y0, y0 + 10, y0 + 10, y0};
+            static_cast<Boundary*>(e)->setXY(x, y);
+            break;
+        }
+        if (round % 2 == 0)
+            warm(lib);
+    }
+    compareReread(lib, "edited boundaries");
+
+    // A structure which takes over the name of a deleted one takes over
+    // its parents as well.
+    std::string name = lib.get(3)->name();
+    lib.del(name);
+    warm(lib);
+    Structure *replacement = lib.add(name);
+    Boundary *b = new Boundary(replacement);
+    std::vector<int> x = {0, 900000, 900000, 0, 0}, y = {0, 0, 900000, 900000, 0};
+    b->setXY(x, y);
+    replacement->add(b);
+    compareReread(lib, "replaced structure");
+
+    // Structures merged in are invalidated through their new library.
+    Library other;
+    generate(other, 20, 60);
+    std::vector<Library*> sources = {&other};
+    lib.merge(sources, 1);
+    warm(lib);
+    Structure *leaf = lib.get((int)lib.size() - 20);
+    Boundary *far = new Boundary(leaf);
+    std::vector<int> fx = {-900000, -800000, -800000, -900000, -900000};
+    std::vector<int> fy = {-900000, -900000, -800000, -800000, -900000};
+    far->setXY(fx, fy);
+    leaf->add(far);
+    compareReread(lib, "merged structures");
+}
+
+static std::vector<std::string> childNames(Structure *s)
+{
+    std::vector<std::string> names;
+    for (Structure *child : s->children())
+        names.push_back(child->name());
+    return names;
+}
+
+/*
+ * Duplicates are dropped, clashing names renamed and references follow.
+ **/
+static void testMerge()
+{
+    Library lib;
+    Seed = 21;
+    generate(lib, 40, 30);
+    std::vector<unsigned long long> hashes;
+    for (size_t i = 0; i < lib.size(); i++)
+        hashes.push_back(lib.get((int)i)->hash());
+
+    // The same cells again.
+    Library same;
+    Seed = 21;
+    generate(same, 40, 30);
+    std::vector<Library*> sources = {&same};
+    check(lib.merge(sources, 2) == 40, "merge of equal cells: dropped");
+    check(lib.size() == 40 && same.size() == 0, "merge of equal cells: sizes");
+
+    // Cells of the same names with other contents are renamed, and so are
+    // the references to them.
+    Library other;
+    Seed = 22;
+    generate(other, 10, 30);
+    std::vector<std::vector<std::string> > children;
+    for (size_t i = 0; i < other.size(); i++)
+        children.push_back(childNames(other.get((int)i)));
+    sources = {&other};
+    check(lib.merge(sources, 1) == 0, "merge of other cells: dropped");
+    check(lib.size() == 50, "merge of other cells: size");
+    for (size_t i = 0; i < 10; i++)
+    {
+        Structure *moved = lib.get(40 + (int)i);
+        std::string what = "merge of other cells: cell_" + std::to_string(i);
+        check(moved->name() == "cell_" + std::to_string(i) + "_1", what + " name");
+        std::vector<std::string> expected = children[i];
+        for (std::string &name : expected)
+            name += "_1";
+        check(childNames(moved) == expected, what + " references");
+    }
+    for (size_t i = 0; i < 40; i++)
+        check(lib.get((int)i)->hash() == hashes[i], "merge keeps cell_" + std::to_string(i));
+
+    // A new parent of copies is kept, and points at the cells kept here.
+    Library parent;
+    Seed = 21;
+    generate(parent, 40, 30);
+    Structure *top = parent.add("new_top");
+    SRef *ref = new SRef(top);
+    ref->setStructName("cell_39");
+    top->add(ref);
+    sources = {&parent};
+    check(lib.merge(sources, 0) == 40, "merge of a new parent: dropped");
+    check(lib.size() == 51, "merge of a new parent: size");
+    Structure *merged = lib.get("new_top");
+    check(merged != nullptr && merged->children().size() == 1
+        && merged->children()[0] == lib.get("cell_39"), "merge of a new parent: reference");
+
+    // Files, the last one all duplicates.
+    const char *paths[] = {"libtest_merge_0.gds", "libtest_merge_1.gds"};
+    Library first, second;
+    Seed = 21;
+    generate(first, 40, 30);
+    Seed = 22;
+    generate(second, 10, 30);
+    {
+        std::ofstream out(paths[0], std::ios::binary);
+        first.write(out);
+    }
+    {
+        std::ofstream out(paths[1], std::ios::binary);
+        second.write(out);
+    }
+    for (int threads = 1; threads <= 3; threads++)
+    {
+        Library files;
+        std::vector<std::string> names = {paths[0], paths[1], paths[0]};
+        check(files.merge(names, threads), "merge of files");
+        check(files.size() == 50, "merge of files with " + std::to_string(threads) + " threads: size");
+        for (size_t i = 0; i < 40 && i < files.size(); i++)
+            check(files.get((int)i)->hash() == hashes[i], "merge of files keeps cell_" + std::to_string(i));
+    }
+    std::remove(paths[0]);
+    std::remove(paths[1]);
+}
+
+/*
+ * Names held outside any library outlive all libraries.
+ **/
+static void testStringLifetime()
+{
+    Structure standalone("kept_outside");
+    Text text(&standalone);
+    text.setString("kept_label");
+    {
+        Library lib;
+        lib.add("inside");
+    }
+    {
+        Library lib;
+        for (int i = 0; i < 100; i++)
+            lib.add("later_" + std::to_string(i));
+        check(lib.get("kept_outside") == nullptr, "no alias of a standalone name");
+    }
+    check(standalone.name() == "kept_outside", "standalone structure name");
+    check(text.string() == "kept_label", "standalone text string");
+}
+
+int main()
+{
+    testRead();
+    testBadIndex();
+    testCaches();
+    testMerge();
+    testStringLifetime();
+    std::remove(Path_name);
+    if (Failures > 0)
+    {
+        std::cout << Failures << " failures" << std::endl;
+        return 1;
+    }
+    std::cout << "all passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,182 @@
+/*
+ * This file is part of GDSII.
+ *
+ * mappedfile.cpp -- The source file which defines the read-only memory
+ *                   mapping of GDSII files.
+ *
+ * Copyright (c) 2015 Kangpeng Shao <billowen035@gmail.com>
+ *
+ * GDSII is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at you option) any later version.
+ *
+ * GDSII is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABLILTY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GDSII. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "mappedfile.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace GDS
+{
+	MappedFile::MappedFile()
+	{
+		Data = nullptr;
+		Size = 0;
+#ifdef _WIN32
+		File_handle = INVALID_HANDLE_VALUE;
+		Map_handle = nullptr;
+#else
+		Fd = -1;
+#endif
+	}
+
+	MappedFile::~MappedFile()
+	{
+		close();
+	}
+
+#ifdef _WIN32
+	bool MappedFile::open(std::string path)
+	{
+		close();
+
+		HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+			OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+		File_handle = file;
+
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(file, &size))
+		{
+			close();
+			return false;
+		}
+		Size = (size_t)size.QuadPart;
+		if (Size == 0)
+			return true;
+
+		HANDLE map = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (map == NULL)
+		{
+			close();
+			return false;
+		}
+		Map_handle = map;
+
+		Data = (const Byte*)MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0);
+		if (Data == nullptr)
+		{
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	void MappedFile::close()
+	{
+		if (Data != nullptr)
+			UnmapViewOfFile(Data);
+		if (Map_handle != nullptr)
+			CloseHandle((HANDLE)Map_handle);
+		if (File_handle != INVALID_HANDLE_VALUE)
+			CloseHandle((HANDLE)File_handle);
+		Data = nullptr;
+		Size = 0;
+		Map_handle = nullptr;
+		File_handle = INVALID_HANDLE_VALUE;
+	}
+
+	bool MappedFile::isOpen() const
+	{
+		return File_handle != INVALID_HANDLE_VALUE;
+	}
+#else
+	bool MappedFile::open(std::string path)
+	{
+		close();
+
+		Fd = ::open(path.c_str(), O_RDONLY);
+		if (Fd < 0)
+			return false;
+
+		struct stat st;
+		if (fstat(Fd, &st) != 0)
+		{
+			close();
+			return false;
+		}
+		Size = (size_t)st.st_size;
+		if (Size == 0)
+			return true;
+
+		void* addr = mmap(nullptr, Size, PROT_READ, MAP_PRIVATE, Fd, 0);
+		if (addr == MAP_FAILED)
+		{
+			close();
+			return false;
+		}
+		madvise(addr, Size, MADV_SEQUENTIAL);
+		Data = (const Byte*)addr;
+		return true;
+	}
+
+	void MappedFile::close()
+	{
+		if (Data != nullptr)
+			munmap((void*)Data, Size);
+		if (Fd >= 0)
+			::close(Fd);
+		Data = nullptr;
+		Size = 0;
+		Fd = -1;
+	}
+
+	bool MappedFile::isOpen() const
+	{
+		return Fd >= 0;
+	}
+#endif
+
+	bool MappedFile::status(std::string path, long long &size, long long &mtime)
+	{
+#ifdef _WIN32
+		struct _stat64 st;
+		if (_stat64(path.c_str(), &st) != 0)
+			return false;
+#else
+		struct stat st;
+		if (::stat(path.c_str(), &st) != 0)
+			return false;
+#endif
+		size = (long long)st.st_size;
+		mtime = (long long)st.st_mtime;
+		return true;
+	}
+
+	const Byte* MappedFile::data() const
+	{
+		return Data;
+	}
+
+	size_t MappedFile::size() const
+	{
+		return Size;
+	}
+}
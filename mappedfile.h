@@ -0,0 +1,78 @@
+/*
+ * This file is part of GDSII.
+ *
+ * mappedfile.h -- The header file which declare the read-only memory
+ *                 mapping of GDSII files.
+ *
+ * Copyright (c) 2015 Kangpeng Shao <billowen035@gmail.com>
+ *
+ * GDSII is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at you option) any later version.
+ *
+ * GDSII is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABLILTY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GDSII. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef GDS_MAPPEDFILE_H
+#define GDS_MAPPEDFILE_H
+
+#include <string>
+#include "tags.h"
+
+namespace GDS
+{
+	/*!
+	 * \brief A file mapped read-only into memory.
+	 *
+	 * The pages are loaded by the operating system on demand, so mapping
+	 * a file costs nothing until its bytes are touched.
+	 */
+	class MappedFile
+	{
+		const Byte*     Data;
+		size_t          Size;
+#ifdef _WIN32
+		void*           File_handle;
+		void*           Map_handle;
+#else
+		int             Fd;
+#endif
+
+		MappedFile(const MappedFile&);
+		MappedFile& operator=(const MappedFile&);
+
+	public:
+		MappedFile();
+		~MappedFile();
+
+		/*!
+		 * Map a file. An already opened mapping is closed first.
+		 *
+		 * \param [in] path		Path of the file.
+		 *
+		 * \return	false if the file can not be opened or mapped.
+		 */
+		bool open(std::string path);
+		void close();
+
+		/*!
+		 * Size and modification time (seconds since the epoch) of a file.
+		 *
+		 * \return	false if the file does not exist.
+		 */
+		static bool status(std::string path, long long &size, long long &mtime);
+
+		bool isOpen() const;
+		const Byte* data() const;
+		size_t size() const;
+	};
+}
+
+#endif
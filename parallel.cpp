@@ -0,0 +1,104 @@
+/*
+ * This file is part of GDSII.
+ *
+ * parallel.cpp -- The source file which defines the helpers used to run
+ *                 independent tasks on several threads.
+ *
+ * Copyright (c) 2015 Kangpeng Shao <billowen035@gmail.com>
+ *
+ * GDSII is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at you option) any later version.
+ *
+ * GDSII is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABLILTY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GDSII. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "parallel.h"
+
+namespace GDS
+{
+	static thread_local int Worker = 0;
+
+	int defaultThreads()
+	{
+#ifdef _DEBUG_LOG
+		return 1;
+#else
+		int n = (int)std::thread::hardware_concurrency();
+		return n > 0 ? n : 1;
+#endif
+	}
+
+	void parallelFor(size_t count, int threads, const std::function<void(size_t)> &task)
+	{
+		if (threads <= 0)
+			threads = defaultThreads();
+#ifdef _DEBUG_LOG
+		threads = 1;
+#endif
+		if ((size_t)threads > count)
+			threads = (int)count;
+
+		if (threads <= 1)
+		{
+			for (size_t i = 0; i < count; i++)
+				task(i);
+			return;
+		}
+
+		std::atomic<size_t> next(0);
+		std::atomic<bool> failed(false);
+		std::exception_ptr error;
+		std::mutex error_mutex;
+
+		auto worker = [&](int id)
+		{
+			Worker = id;
+			while (!failed)
+			{
+				size_t i = next++;
+				if (i >= count)
+					break;
+				try
+				{
+					task(i);
+				}
+				catch (...)
+				{
+					std::lock_guard<std::mutex> lock(error_mutex);
+					if (!error)
+						error = std::current_exception();
+					failed = true;
+				}
+			}
+			Worker = 0;
+		};
+
+		std::vector<std::thread> pool;
+		for (int t = 1; t < threads; t++)
+			pool.push_back(std::thread(worker, t));
+		worker(0);
+		for (std::thread &t : pool)
+			t.join();
+
+		if (error)
+			std::rethrow_exception(error);
+	}
+
+	int currentWorker()
+	{
+		return Worker;
+	}
+}
@@ -0,0 +1,63 @@
+/*
+ * This file is part of GDSII.
+ *
+ * parallel.h -- The header file which declare the helpers used to run
+ *               independent tasks on several threads.
+ *
+ * Copyright (c) 2015 Kangpeng Shao <billowen035@gmail.com>
+ *
+ * GDSII is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at you option) any later version.
+ *
+ * GDSII is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABLILTY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GDSII. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef GDS_PARALLEL_H
+#define GDS_PARALLEL_H
+
+#include <cstddef>
+#include <functional>
+
+namespace GDS
+{
+	/*!
+	 * \brief Number of threads to use when the caller asks for 0.
+	 *
+	 * It is the number of hardware threads, or 1 if the library is built
+	 * with _DEBUG_LOG since the log is not thread-safe.
+	 */
+	int defaultThreads();
+
+	/*!
+	 * \brief Run task(0) .. task(count - 1) on a pool of threads.
+	 *
+	 * Tasks are handed out one by one from a shared counter, so uneven tasks
+	 * balance themselves. The call returns when all tasks are done. If a task
+	 * throws, the remaining tasks are skipped and the first exception is
+	 * rethrown in the calling thread.
+	 *
+	 * \param [in] count		Number of tasks.
+	 * \param [in] threads		Number of threads, 0 for defaultThreads().
+	 * \param [in] task			The task to run with the index of the task.
+	 */
+	void parallelFor(size_t count, int threads, const std::function<void(size_t)> &task);
+
+	/*!
+	 * \brief Index of the pool thread running the current task.
+	 *
+	 * The threads of a parallelFor() are numbered from 0, the calling
+	 * thread being 0, so tasks can keep per-thread buffers. Outside of a
+	 * parallelFor() it is 0.
+	 */
+	int currentWorker();
+}
+
+#endif
@@ -25,12 +25,13 @@
 #include "log.h"
 #include <sstream>
 #include <algorithm>
+#include <cmath>
 #include "gdsio.h"
 
 namespace GDS
 {
 
-	Path::Path(Structure* parent) :Element(PATH, parent)
+	Path::Path(Structure* parent) :Element(PATH, parent), X(storage()), Y(storage())
 	{
 		Eflags = 0;
 		Layer = -1;
@@ -72,55 +73,165 @@ namespace GDS
 		return Path_type;
 	}
 
+	size_t Path::pointCount() const
+	{
+		return X.size();
+	}
+
+	const int* Path::xData() const
+	{
+		return X.data();
+	}
+
+	const int* Path::yData() const
+	{
+		return Y.data();
+	}
+
 	void Path::xy(std::vector<int> &x, std::vector<int> &y) const
 	{
-		x = X;
-		y = Y;
+		x.assign(X.begin(), X.end());
+		y.assign(Y.begin(), Y.end());
+	}
+
+	// Adds the corners of an extended end of a path, from vertex 'to' away
+	// from vertex 'from'.
+	static void addEnd(Box &box, int from_x, int from_y, int to_x, int to_y, double half, double extension)
+	{
+		double dx = (double)to_x - from_x, dy = (double)to_y - from_y;
+		double length = std::sqrt(dx * dx + dy * dy);
+		if (length == 0)
+			return;
+		dx /= length;
+		dy /= length;
+		for (int side = -1; side <= 1; side += 2)
+		{
+			double x = to_x + dx * extension - dy * half * side;
+			double y = to_y + dy * extension + dx * half * side;
+			box.add(Box((int)std::floor(x), (int)std::floor(y), (int)std::ceil(x), (int)std::ceil(y)));
+		}
+	}
+
+	// Adds the miter points of the join at (x1, y1) between the segments
+	// from (x0, y0) and to (x2, y2). Miters are cut at the default miter
+	// limit of PathConverter, 2, beyond which the join is bevelled within
+	// half the width of the vertex.
+	static void addJoin(Box &box, int x0, int y0, int x1, int y1, int x2, int y2, double half)
+	{
+		double ax = (double)x1 - x0, ay = (double)y1 - y0;
+		double bx = (double)x2 - x1, by = (double)y2 - y1;
+		double la = std::sqrt(ax * ax + ay * ay), lb = std::sqrt(bx * bx + by * by);
+		if (la == 0 || lb == 0)
+			return;
+		ax /= la;
+		ay /= la;
+		bx /= lb;
+		by /= lb;
+		double dot = ax * bx + ay * by;
+		if (1 + dot < 0.5)
+			return;
+		for (int side = -1; side <= 1; side += 2)
+		{
+			double x = x1 + side * (ay + by) * half / (1 + dot);
+			double y = y1 - side * (ax + bx) * half / (1 + dot);
+			box.add(Box((int)std::floor(x), (int)std::floor(y), (int)std::ceil(x), (int)std::ceil(y)));
+		}
+	}
+
+	Box Path::bbox() const
+	{
+		Box box;
+		size_t n = X.size();
+		int width = Width < 0 ? -Width : Width;
+		int half = (width + 1) / 2;
+		for (size_t i = 0; i < n; i++)
+		{
+			box.add(X[i] - half, Y[i] - half);
+			box.add(X[i] + half, Y[i] + half);
+		}
+		if (n < 2)
+			return box;
+		double begin = 0, end = 0;
+		if (Path_type == 2)
+		{
+			begin = end = width / 2.0;
+		}
+		else if (Path_type == 4)
+		{
+			begin = Begin_extn;
+			end = End_extn;
+		}
+		// Repeated vertices are skipped, as PathConverter does.
+		size_t last = 0;        // Last vertex before i.
+		size_t before = n;      // Vertex before last, n if none.
+		for (size_t i = 1; i < n; i++)
+		{
+			if (X[i] == X[i - 1] && Y[i] == Y[i - 1])
+				continue;
+			if (before == n)
+				addEnd(box, X[i], Y[i], X[0], Y[0], width / 2.0, begin);
+			else
+				addJoin(box, X[before], Y[before], X[last], Y[last], X[i], Y[i], width / 2.0);
+			before = last;
+			last = i;
+		}
+		if (before != n)
+			addEnd(box, X[before], Y[before], X[last], Y[last], width / 2.0, end);
+		return box;
 	}
 
 	void Path::setLayer(short layer)
 	{
 		Layer = layer;
+		touch();
 	}
 
 	void Path::setDataType(short data_type)
 	{
 		Data_type = data_type;
+		touch();
 	}
 
 	void Path::setWidth(int width)
 	{
 		Width = width;
+		touch();
 	}
 
 	void Path::setExtension(int begin, int end)
 	{
 		Begin_extn = begin;
 		End_extn = end;
+		touch();
 	}
 
 	void Path::setPathType(int type)
 	{
 		Path_type = type;
+		touch();
 	}
 
 	void Path::setXY(std::vector<int> &x, std::vector<int> &y)
 	{
-		X = x;
-		Y = y;
+		X.assign(x.begin(), x.end());
+		Y.assign(y.begin(), y.end());
+		touch();
 	}
 
-	bool Path::read(std::ifstream &in)
+	bool Path::read(RecordReader &reader)
 	{
 #ifdef _DEBUG_LOG
         LogIO* log = LogIO::getInstance();
 #endif
+		const Record &rec = reader.record();
 		bool finished = false;
 		while (!finished)
 		{
-			short record_size = readShort(in);
-			Byte record_type = readByte(in);
-			Byte data_type = readByte(in);
+			if (!reader.next())
+				throw FormatError("unexpected end of file in PATH.");
+			int record_size = rec.size;
+			Byte record_type = rec.record_type;
+			Byte data_type = rec.data_type;
 			switch (record_type)
 			{
 			case ENDEL:
@@ -143,7 +254,7 @@ namespace GDS
 					std::string msg = ss.str();
 					throw FormatError(msg);
 				}
-				Eflags = readShort(in);
+				Eflags = rec.getShort();
 #ifdef _DEBUG_LOG
                 {
                     std::stringstream ss;
@@ -162,7 +273,7 @@ namespace GDS
 					std::string msg = ss.str();
 					throw FormatError(msg);
 				}
-				Layer = readShort(in);
+				Layer = rec.getShort();
 #ifdef _DEBUG_LOG
                 {
                     std::stringstream ss;
@@ -181,7 +292,7 @@ namespace GDS
 					std::string msg = ss.str();
 					throw FormatError(msg);
 				}
-				Data_type = readShort(in);
+				Data_type = rec.getShort();
 #ifdef _DEBUG_LOG
                 {
                     std::stringstream ss;
@@ -203,13 +314,10 @@ namespace GDS
 					std::string msg = ss.str();
 					throw FormatError(msg);
 				}
-				for (int i = 0; i < num; i++)
-				{
-					int x = readInteger(in);
-					int y = readInteger(in);
-					X.push_back(x);
-					Y.push_back(y);
-				}
+				size_t begin = X.size();
+				X.resize(begin + num);
+				Y.resize(begin + num);
+				decodeXY(rec.data, num, &X[begin], &Y[begin]);
 #ifdef _DEBUG_LOG
                 {
                     std::stringstream ss;
@@ -234,7 +342,7 @@ namespace GDS
 					std::string msg = ss.str();
 					throw FormatError(msg);
 				}
-				Width = readInteger(in);
+				Width = rec.getInteger();
 #ifdef _DEBUG_LOG
                 {
                     std::stringstream ss;
@@ -253,7 +361,7 @@ namespace GDS
 					std::string msg = ss.str();
 					throw FormatError(msg);
 				}
-				Begin_extn = readInteger(in);
+				Begin_extn = rec.getInteger();
 #ifdef _DEBUG_LOG
                 {
                     std::stringstream ss;
@@ -272,7 +380,7 @@ namespace GDS
 					std::string msg = ss.str();
 					throw FormatError(msg);
 				}
-				End_extn = readInteger(in);
+				End_extn = rec.getInteger();
 #ifdef _DEBUG_LOG
                 {
                     std::stringstream ss;
@@ -291,7 +399,7 @@ namespace GDS
 					std::string msg = ss.str();
 					throw FormatError(msg);
 				}
-				Path_type = readShort(in);
+				Path_type = rec.getShort();
 #ifdef _DEBUG_LOG
                 {
                     std::stringstream ss;
@@ -308,71 +416,18 @@ namespace GDS
 		return true;
 	}
 
-	bool Path::write(std::ofstream &out)
+	bool Path::write(RecordWriter &writer)
 	{
-		short record_size;
-
-		record_size = 4;
-		writeShort(out, record_size);
-		writeByte(out, PATH);
-		writeByte(out, NoData);
-
-		record_size = 6;
-		writeShort(out, record_size);
-		writeByte(out, EFLAGS);
-		writeByte(out, Integer_2);
-		writeShort(out, Eflags);
-
-		record_size = 6;
-		writeShort(out, record_size);
-		writeByte(out, LAYER);
-		writeByte(out, Integer_2);
-		writeShort(out, Layer);
-
-		record_size = 6;
-		writeShort(out, record_size);
-		writeByte(out, DATATYPE);
-		writeByte(out, Integer_2);
-		writeShort(out, Data_type);
-
-		record_size = 8;
-		writeShort(out, record_size);
-		writeByte(out, WIDTH);
-		writeByte(out, Integer_4);
-		writeInteger(out, Width);
-
-		record_size = 8;
-		writeShort(out, record_size);
-		writeByte(out, BGNEXTN);
-		writeByte(out, Integer_4);
-		writeInteger(out, Begin_extn);
-
-		record_size = 8;
-		writeShort(out, record_size);
-		writeByte(out, ENDEXTN);
-		writeByte(out, Integer_4);
-		writeInteger(out, End_extn);
-
-		record_size = 6;
-		writeShort(out, record_size);
-		writeByte(out, PATHTYPE);
-		writeByte(out, Integer_2);
-		writeShort(out, Path_type);
-
-		record_size = 4 + 8 * X.size();
-		writeShort(out, record_size);
-		writeByte(out, XY);
-		writeByte(out, Integer_4);
-		for (size_t i = 0; i < X.size(); i++)
-		{
-			writeInteger(out, X[i]);
-			writeInteger(out, Y[i]);
-		}
-
-		record_size = 4;
-		writeShort(out, record_size);
-		writeByte(out, ENDEL);
-		writeByte(out, NoData);
+		writer.writeRecord(PATH);
+		writer.writeShort(EFLAGS, Eflags);
+		writer.writeShort(LAYER, Layer);
+		writer.writeShort(DATATYPE, Data_type);
+		writer.writeInteger(WIDTH, Width);
+		writer.writeInteger(BGNEXTN, Begin_extn);
+		writer.writeInteger(ENDEXTN, End_extn);
+		writer.writeShort(PATHTYPE, Path_type);
+		writer.writeXY(X.data(), Y.data(), (int)X.size());
+		writer.writeRecord(ENDEL);
 
 		return true;
 	}
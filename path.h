@@ -22,6 +22,7 @@
 #ifndef PATH_H
 #define PATH_H
 #include "elements.h"
+#include "geometry.h"
 
 namespace GDS {
 
@@ -49,7 +50,7 @@ namespace GDS {
 		int                 Begin_extn;
 		int                 End_extn;
 		short               Path_type;
-		std::vector<int>    X, Y;
+		Coordinates         X, Y;
 
 	public:
 		Path(Structure* parent = nullptr);
@@ -60,7 +61,19 @@ namespace GDS {
 		int width() const;
 		void extension(int &begin, int &end) const;
 		int pathType() const;
+		size_t pointCount() const;
+		const int* xData() const;
+		const int* yData() const;
 		void xy(std::vector<int> &x, std::vector<int> &y) const;
+		/*!
+		 * \brief Box of the area covered by the path.
+		 *
+		 * Every vertex is padded by half the width, the ends are extended
+		 * as the path type says, and the miters of the joins are added, so
+		 * the box holds the outline of PathConverter with its default miter
+		 * limit.
+		 */
+		Box bbox() const;
 
 		void setLayer(short layer);
 		void setDataType(short data_type);
@@ -69,8 +82,8 @@ namespace GDS {
 		void setPathType(int type);
 		void setXY(std::vector<int> &x, std::vector<int> &y);
 
-		virtual bool read(std::ifstream &in);
-		virtual bool write(std::ofstream &out);
+		virtual bool read(RecordReader &reader);
+		virtual bool write(RecordWriter &writer);
 		virtual bool printASCII(std::ofstream &out);
 	};
 
@@ -0,0 +1,504 @@
+/*
+ * This file is part of GDSII.
+ *
+ * polygons.cpp -- The source file which defines the polygon sets and the
+ *                 conversion of paths to polygons.
+ *
+ * Copyright (c) 2015 Kangpeng Shao <billowen035@gmail.com>
+ *
+ * GDSII is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at you option) any later version.
+ *
+ * GDSII is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABLILTY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GDSII. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "polygons.h"
+#include "path.h"
+#include "parallel.h"
+
+namespace GDS
+{
+	static const double Pi = 3.14159265358979323846;
+
+	static int clampInt(long long v)
+	{
+		if (v < std::numeric_limits<int>::min())
+			return std::numeric_limits<int>::min();
+		if (v > std::numeric_limits<int>::max())
+			return std::numeric_limits<int>::max();
+		return (int)v;
+	}
+
+	static int roundInt(double v)
+	{
+		v = std::floor(v + 0.5);
+		if (v < std::numeric_limits<int>::min())
+			return std::numeric_limits<int>::min();
+		if (v > std::numeric_limits<int>::max())
+			return std::numeric_limits<int>::max();
+		return (int)v;
+	}
+
+	PolygonSet::PolygonSet()
+	{
+		Offsets.push_back(0);
+	}
+
+	size_t PolygonSet::size() const
+	{
+		return Offsets.size() - 1;
+	}
+
+	size_t PolygonSet::vertexCount() const
+	{
+		return Offsets.back();
+	}
+
+	PointRange PolygonSet::get(size_t index) const
+	{
+		size_t begin = Offsets[index];
+		PointRange range = { X.data() + begin, Y.data() + begin, Offsets[index + 1] - begin };
+		return range;
+	}
+
+	void PolygonSet::add(const int *x, const int *y, size_t count)
+	{
+		X.resize(Offsets.back());
+		Y.resize(Offsets.back());
+		if (count < 3)
+			return;
+		X.insert(X.end(), x, x + count);
+		Y.insert(Y.end(), y, y + count);
+		Offsets.push_back(X.size());
+	}
+
+	void PolygonSet::addBoundaries(const LayerShapes &shapes)
+	{
+		reserve(shapes.boundaryCount(), shapes.vertexCount());
+		for (size_t i = 0; i < shapes.boundaryCount(); i++)
+		{
+			PointRange points = shapes.boundary(i);
+			size_t count = points.Count;
+			if (count > 1 && points.X[0] == points.X[count - 1] && points.Y[0] == points.Y[count - 1])
+				count--;
+			add(points.X, points.Y, count);
+		}
+	}
+
+	void PolygonSet::push(int x, int y)
+	{
+		X.push_back(x);
+		Y.push_back(y);
+	}
+
+	void PolygonSet::close()
+	{
+		if (X.size() - Offsets.back() < 3)
+		{
+			X.resize(Offsets.back());
+			Y.resize(Offsets.back());
+			return;
+		}
+		Offsets.push_back(X.size());
+	}
+
+	void PolygonSet::append(const PolygonSet &other)
+	{
+		X.resize(Offsets.back());
+		Y.resize(Offsets.back());
+		size_t base = X.size();
+		X.insert(X.end(), other.X.begin(), other.X.begin() + other.Offsets.back());
+		Y.insert(Y.end(), other.Y.begin(), other.Y.begin() + other.Offsets.back());
+		for (size_t i = 1; i < other.Offsets.size(); i++)
+			Offsets.push_back(base + other.Offsets[i]);
+	}
+
+	void PolygonSet::reserve(size_t polygons, size_t vertices)
+	{
+		Offsets.reserve(Offsets.size() + polygons);
+		X.reserve(X.size() + vertices);
+		Y.reserve(Y.size() + vertices);
+	}
+
+	void PolygonSet::clear()
+	{
+		X.clear();
+		Y.clear();
+		Offsets.assign(1, 0);
+	}
+
+	double PolygonSet::area() const
+	{
+		double total = 0;
+		for (size_t i = 0; i + 1 < Offsets.size(); i++)
+		{
+			size_t begin = Offsets[i], end = Offsets[i + 1];
+			// Relative to the first vertex, so the products stay exact.
+			long long x0 = X[begin], y0 = Y[begin];
+			double twice = 0;
+			for (size_t k = begin + 1; k + 1 < end; k++)
+			{
+				long long ax = X[k] - x0, ay = Y[k] - y0;
+				long long bx = X[k + 1] - x0, by = Y[k + 1] - y0;
+				twice += (double)ax * by - (double)ay * bx;
+			}
+			total += twice / 2;
+		}
+		return total;
+	}
+
+	// Vertices of a path without repeated points.
+	struct PathScratch
+	{
+		std::vector<long long>  X, Y;
+
+		void load(const int *x, const int *y, size_t count)
+		{
+			X.clear();
+			Y.clear();
+			for (size_t i = 0; i < count; i++)
+			{
+				if (i > 0 && x[i] == X.back() && y[i] == Y.back())
+					continue;
+				X.push_back(x[i]);
+				Y.push_back(y[i]);
+			}
+		}
+	};
+
+	// Outline of a path whose segments are all axis aligned, with an
+	// integer half width and integer extensions.
+	struct ManhattanOutline
+	{
+		const PathScratch   &Points;
+		long long           Half;
+		bool                Miter;      // Right angles are mitred.
+		PolygonSet          &Out;
+
+		ManhattanOutline(const PathScratch &points, long long half, bool miter, PolygonSet &out)
+			: Points(points), Half(half), Miter(miter), Out(out) {}
+
+		void push(long long x, long long y)
+		{
+			Out.push(clampInt(x), clampInt(y));
+		}
+
+		static int sign(long long v)
+		{
+			return (v > 0) - (v < 0);
+		}
+
+		// Unit direction of segment i.
+		void direction(size_t i, int &dx, int &dy) const
+		{
+			dx = sign(Points.X[i + 1] - Points.X[i]);
+			dy = sign(Points.Y[i + 1] - Points.Y[i]);
+		}
+
+		// Points of the join at vertex i, on the right side (side 1) or the
+		// left side (side -1), in the direction of the path.
+		int join(size_t i, int side, long long *x, long long *y) const
+		{
+			int ax, ay, bx, by;
+			direction(i - 1, ax, ay);
+			direction(i, bx, by);
+			long long vx = Points.X[i], vy = Points.Y[i];
+			// Right normal of (dx, dy) is (dy, -dx).
+			long long nax = side * ay * Half, nay = -side * ax * Half;
+			long long nbx = side * by * Half, nby = -side * bx * Half;
+			int dot = ax * bx + ay * by;
+			int cross = ax * by - ay * bx;
+			if (dot == 1)
+			{
+				x[0] = vx + nax;
+				y[0] = vy + nay;
+				return 1;
+			}
+			if (dot == 0 && Miter)
+			{
+				x[0] = vx + nax + nbx;
+				y[0] = vy + nay + nby;
+				return 1;
+			}
+			bool outer = (cross > 0) == (side > 0);
+			x[0] = vx + nax;
+			y[0] = vy + nay;
+			if (outer || cross == 0)
+			{
+				x[1] = vx + nbx;
+				y[1] = vy + nby;
+				return 2;
+			}
+			x[1] = vx;
+			y[1] = vy;
+			x[2] = vx + nbx;
+			y[2] = vy + nby;
+			return 3;
+		}
+
+		void run(long long begin_extn, long long end_extn)
+		{
+			size_t n = Points.X.size();
+			int bx, by, ex, ey;
+			direction(0, bx, by);
+			direction(n - 2, ex, ey);
+			long long sx = Points.X[0] - bx * begin_extn, sy = Points.Y[0] - by * begin_extn;
+			long long tx = Points.X[n - 1] + ex * end_extn, ty = Points.Y[n - 1] + ey * end_extn;
+
+			long long jx[3], jy[3];
+			push(sx + by * Half, sy - bx * Half);
+			for (size_t i = 1; i + 1 < n; i++)
+			{
+				int count = join(i, 1, jx, jy);
+				for (int k = 0; k < count; k++)
+					push(jx[k], jy[k]);
+			}
+			push(tx + ey * Half, ty - ex * Half);
+			push(tx - ey * Half, ty + ex * Half);
+			for (size_t i = n - 2; i >= 1; i--)
+			{
+				int count = join(i, -1, jx, jy);
+				for (int k = count; k-- > 0;)
+					push(jx[k], jy[k]);
+			}
+			push(sx - by * Half, sy + bx * Half);
+			Out.close();
+		}
+	};
+
+	// Outline of any path, in floating point.
+	struct GeneralOutline
+	{
+		const PathScratch   &Points;
+		double              Half;
+		double              Miter_limit;
+		int                 Round_segments;
+		PolygonSet          &Out;
+
+		GeneralOutline(const PathScratch &points, double half, double miter_limit, int round_segments,
+			PolygonSet &out)
+			: Points(points), Half(half), Miter_limit(miter_limit), Round_segments(round_segments), Out(out) {}
+
+		void push(double x, double y)
+		{
+			Out.push(roundInt(x), roundInt(y));
+		}
+
+		void direction(size_t i, double &dx, double &dy) const
+		{
+			dx = (double)(Points.X[i + 1] - Points.X[i]);
+			dy = (double)(Points.Y[i + 1] - Points.Y[i]);
+			double length = std::sqrt(dx * dx + dy * dy);
+			dx /= length;
+			dy /= length;
+		}
+
+		int join(size_t i, int side, double *x, double *y) const
+		{
+			double ax, ay, bx, by;
+			direction(i - 1, ax, ay);
+			direction(i, bx, by);
+			double vx = (double)Points.X[i], vy = (double)Points.Y[i];
+			double nax = side * ay, nay = -side * ax;
+			double nbx = side * by, nby = -side * bx;
+			double dot = ax * bx + ay * by;
+			double cross = ax * by - ay * bx;
+			if (std::fabs(cross) < 1e-12 && dot > 0)
+			{
+				x[0] = vx + nax * Half;
+				y[0] = vy + nay * Half;
+				return 1;
+			}
+			// The miter length over half the width is sqrt(2 / (1 + dot)).
+			if (1 + dot >= 2 / (Miter_limit * Miter_limit))
+			{
+				x[0] = vx + (nax + nbx) * Half / (1 + dot);
+				y[0] = vy + (nay + nby) * Half / (1 + dot);
+				return 1;
+			}
+			bool outer = (cross > 0) == (side > 0);
+			x[0] = vx + nax * Half;
+			y[0] = vy + nay * Half;
+			if (outer || std::fabs(cross) < 1e-12)
+			{
+				x[1] = vx + nbx * Half;
+				y[1] = vy + nby * Half;
+				return 2;
+			}
+			x[1] = vx;
+			y[1] = vy;
+			x[2] = vx + nbx * Half;
+			y[2] = vy + nby * Half;
+			return 3;
+		}
+
+		// Points of a half circle around (cx, cy), counterclockwise from
+		// the side at angle 'from', both ends excluded.
+		void arc(double cx, double cy, double from)
+		{
+			int steps = Round_segments / 2;
+			for (int k = 1; k < steps; k++)
+			{
+				double angle = from + Pi * k / steps;
+				push(cx + Half * std::cos(angle), cy + Half * std::sin(angle));
+			}
+		}
+
+		void run(double begin_extn, double end_extn, bool round)
+		{
+			size_t n = Points.X.size();
+			double bx, by, ex, ey;
+			direction(0, bx, by);
+			direction(n - 2, ex, ey);
+			double sx = Points.X[0] - bx * begin_extn, sy = Points.Y[0] - by * begin_extn;
+			double tx = Points.X[n - 1] + ex * end_extn, ty = Points.Y[n - 1] + ey * end_extn;
+
+			double jx[3], jy[3];
+			push(sx + by * Half, sy - bx * Half);
+			for (size_t i = 1; i + 1 < n; i++)
+			{
+				int count = join(i, 1, jx, jy);
+				for (int k = 0; k < count; k++)
+					push(jx[k], jy[k]);
+			}
+			push(tx + ey * Half, ty - ex * Half);
+			if (round)
+				arc(tx, ty, std::atan2(-ex, ey));
+			push(tx - ey * Half, ty + ex * Half);
+			for (size_t i = n - 2; i >= 1; i--)
+			{
+				int count = join(i, -1, jx, jy);
+				for (int k = count; k-- > 0;)
+					push(jx[k], jy[k]);
+			}
+			push(sx - by * Half, sy + bx * Half);
+			if (round)
+				arc(sx, sy, std::atan2(bx, -by));
+			Out.close();
+		}
+	};
+
+	PathConverter::PathConverter()
+	{
+		Round_segments = 32;
+		Miter_limit = 2;
+	}
+
+	void PathConverter::setRoundSegments(int segments)
+	{
+		Round_segments = std::max(segments, 4);
+	}
+
+	void PathConverter::setMiterLimit(double limit)
+	{
+		Miter_limit = std::max(limit, 1.0);
+	}
+
+	bool PathConverter::convert(const int *x, const int *y, size_t count, int width, int path_type,
+		int begin_extn, int end_extn, PolygonSet &out) const
+	{
+		static thread_local PathScratch points;
+		points.load(x, y, count);
+		long long full = width < 0 ? -(long long)width : width;
+		if (full == 0 || points.X.empty())
+			return false;
+
+		if (points.X.size() == 1)
+		{
+			double cx = (double)points.X[0], cy = (double)points.Y[0], half = full / 2.0;
+			if (path_type == 1)
+			{
+				for (int k = 0; k < Round_segments; k++)
+				{
+					double angle = 2 * Pi * k / Round_segments;
+					out.push(roundInt(cx + half * std::cos(angle)), roundInt(cy + half * std::sin(angle)));
+				}
+			}
+			else if (path_type == 2)
+			{
+				out.push(roundInt(cx - half), roundInt(cy - half));
+				out.push(roundInt(cx + half), roundInt(cy - half));
+				out.push(roundInt(cx + half), roundInt(cy + half));
+				out.push(roundInt(cx - half), roundInt(cy + half));
+			}
+			else
+			{
+				return false;
+			}
+			out.close();
+			return true;
+		}
+
+		if (path_type != 4)
+			begin_extn = end_extn = 0;
+		bool manhattan = path_type != 1 && full % 2 == 0;
+		for (size_t i = 0; manhattan && i + 1 < points.X.size(); i++)
+			manhattan = points.X[i] == points.X[i + 1] || points.Y[i] == points.Y[i + 1];
+		if (manhattan)
+		{
+			long long half = full / 2;
+			ManhattanOutline outline(points, half, Miter_limit * Miter_limit >= 2, out);
+			if (path_type == 2)
+				outline.run(half, half);
+			else
+				outline.run(begin_extn, end_extn);
+			return true;
+		}
+
+		GeneralOutline outline(points, full / 2.0, Miter_limit, Round_segments, out);
+		if (path_type == 2)
+			outline.run(full / 2.0, full / 2.0, false);
+		else
+			outline.run(begin_extn, end_extn, path_type == 1);
+		return true;
+	}
+
+	bool PathConverter::convert(const Path &path, PolygonSet &out) const
+	{
+		int begin_extn, end_extn;
+		path.extension(begin_extn, end_extn);
+		return convert(path.xData(), path.yData(), path.pointCount(), path.width(), path.pathType(),
+			begin_extn, end_extn, out);
+	}
+
+	size_t PathConverter::convert(const LayerShapes &shapes, PolygonSet &out) const
+	{
+		size_t paths = shapes.pathCount();
+		size_t vertices = shapes.vertexCount();
+		for (size_t i = 0; i < shapes.boundaryCount(); i++)
+			vertices -= shapes.boundary(i).Count;
+		// Two sides per path, plus the ends.
+		out.reserve(paths, 2 * vertices + 4 * paths);
+
+		size_t before = out.size();
+		for (size_t i = 0; i < paths; i++)
+		{
+			PointRange points = shapes.path(i);
+			int begin_extn, end_extn;
+			shapes.pathExtension(i, begin_extn, end_extn);
+			convert(points.X, points.Y, points.Count, shapes.pathWidth(i), shapes.pathType(i),
+				begin_extn, end_extn, out);
+		}
+		return out.size() - before;
+	}
+
+	void PathConverter::convert(const LayerStore &store, std::vector<PolygonSet> &out, int threads) const
+	{
+		out.assign(store.size(), PolygonSet());
+		parallelFor(store.size(), threads, [&](size_t i)
+		{
+			convert(store.get(i), out[i]);
+		});
+	}
+}
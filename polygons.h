@@ -0,0 +1,148 @@
+/*
+ * This file is part of GDSII.
+ *
+ * polygons.h -- The header file which declare the polygon sets and the
+ *               conversion of paths to polygons.
+ *
+ * Copyright (c) 2015 Kangpeng Shao <billowen035@gmail.com>
+ *
+ * GDSII is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at you option) any later version.
+ *
+ * GDSII is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABLILTY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GDSII. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef GDS_POLYGONS_H
+#define GDS_POLYGONS_H
+
+#include <cstddef>
+#include <vector>
+#include "layerstore.h"
+
+namespace GDS
+{
+	class Path;
+
+	/*!
+	 * \brief Polygons sharing one vertex pool.
+	 *
+	 * Polygon i covers the pool range [offsets[i], offsets[i + 1]). The
+	 * first vertex is not repeated at the end.
+	 */
+	class PolygonSet
+	{
+		std::vector<int>    X, Y;
+		std::vector<size_t> Offsets;
+
+	public:
+		PolygonSet();
+
+		size_t size() const;
+		size_t vertexCount() const;
+		PointRange get(size_t index) const;
+
+		void add(const int *x, const int *y, size_t count);
+		/*!
+		 * \brief Append the boundaries of a layer.
+		 *
+		 * The closing vertex, which repeats the first in GDSII, is dropped.
+		 * Paths are not included; see PathConverter.
+		 */
+		void addBoundaries(const LayerShapes &shapes);
+		/*!
+		 * \brief Append a vertex to the polygon being built.
+		 *
+		 * The polygon is ended by close().
+		 */
+		void push(int x, int y);
+		/*!
+		 * End the polygon being built. Polygons with less than 3 vertices
+		 * are dropped.
+		 */
+		void close();
+		void append(const PolygonSet &other);
+		void reserve(size_t polygons, size_t vertices);
+		void clear();
+
+		/*!
+		 * \brief Sum of the signed areas of the polygons.
+		 *
+		 * Counterclockwise polygons count positive. Overlaps are not merged.
+		 */
+		double area() const;
+	};
+
+	/*!
+	 * \brief Outlines of paths.
+	 *
+	 * The outline follows the centre line at half the width on each side.
+	 * The ends are cut square at the end vertices (PATHTYPE 0), extended by
+	 * half the width (2) or by BGNEXTN and ENDEXTN (4), or closed by half
+	 * circles (1). Joins are mitred; a join sharper than the miter limit
+	 * is bevelled on its outer side, and its inner side passes through the
+	 * vertex, so that the outline covers the path with the nonzero rule.
+	 * A negative width is absolute and is used as its magnitude. Paths of
+	 * a single point give a square (type 2) or a circle (type 1).
+	 *
+	 * Paths whose segments are all horizontal or vertical, with an even
+	 * width and not round, are converted in integer arithmetic. The
+	 * polygons are counterclockwise.
+	 */
+	class PathConverter
+	{
+		int         Round_segments;
+		double      Miter_limit;
+
+	public:
+		PathConverter();
+
+		/*!
+		 * \param [in] segments		Segments of a full circle for round ends,
+		 *							at least 4. The default is 32.
+		 */
+		void setRoundSegments(int segments);
+		/*!
+		 * \param [in] limit		Largest ratio of the miter length to half
+		 *							the width, at least 1. The default is 2,
+		 *							which bevels joins sharper than 60 degrees.
+		 *							Path::bbox() assumes the default; with a
+		 *							larger limit, outlines may leave it.
+		 */
+		void setMiterLimit(double limit);
+
+		/*!
+		 * \brief Append the outline of a path.
+		 *
+		 * \return	false if the path has no area, such as a zero width.
+		 */
+		bool convert(const int *x, const int *y, size_t count, int width, int path_type,
+			int begin_extn, int end_extn, PolygonSet &out) const;
+		bool convert(const Path &path, PolygonSet &out) const;
+		/*!
+		 * \brief Append the outlines of all paths of a layer, in order.
+		 *
+		 * \return	The number of polygons appended.
+		 */
+		size_t convert(const LayerShapes &shapes, PolygonSet &out) const;
+		/*!
+		 * \brief Convert the paths of every layer of a store.
+		 *
+		 * Layers are converted on several threads. Layers without paths
+		 * give empty sets.
+		 *
+		 * \param [out] out			One set per layer of the store, in its order.
+		 * \param [in] threads		Number of threads, 0 for defaultThreads().
+		 */
+		void convert(const LayerStore &store, std::vector<PolygonSet> &out, int threads = 0) const;
+	};
+}
+
+#endif
@@ -0,0 +1,200 @@
+/*
+ * This file is part of GDSII.
+ *
+ * realtest.cpp -- Tests of the conversion between 8-byte GDSII reals and
+ *                 IEEE-754 doubles.
+ *
+ * Copyright (c) 2015 Kangpeng Shao <billowen035@gmail.com>
+ *
+ * GDSII is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at you option) any later version.
+ *
+ * GDSII is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABLILTY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GDSII. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include "gdsio.h"
+
+using GDS::Byte;
+
+static int Failures = 0;
+
+static void makeReal(bool negative, int exponent, unsigned long long fraction, Byte *data)
+{
+    data[0] = (negative ? 0x80 : 0) | (Byte)exponent;
+    for (int i = 7; i >= 1; i--)
+    {
+        data[i] = fraction & 0xff;
+        fraction >>= 8;
+    }
+}
+
+static std::string hex(const Byte *data)
+{
+    std::stringstream ss;
+    ss << std::hex << std::setfill('0');
+    for (int i = 0; i < 8; i++)
+        ss << std::setw(2) << (int)data[i];
+    return ss.str();
+}
+
+/*
+ * Same bits, so that the signs of zeros count.
+ **/
+static bool same(double a, double b)
+{
+    return memcmp(&a, &b, 8) == 0;
+}
+
+static void fail(const std::string &what, const Byte *data, double value)
+{
+    Failures++;
+    if (Failures <= 20)
+    {
+        std::cout << "FAIL " << what << ": " << hex(data) << " "
+                  << std::setprecision(17) << value << std::endl;
+    }
+}
+
+/*
+ * Decode a GDSII real, compare it with the expected double, encode it
+ * again and compare the bytes, or the value if the GDSII real has no
+ * double of its own.
+ **/
+static void checkReal(const Byte *data, double expected, bool exact_bytes)
+{
+    double value = GDS::bytesToDouble(data);
+    if (!same(value, expected))
+        fail("decode", data, value);
+
+    Byte again[8];
+    GDS::doubleToBytes(value, again);
+    if (exact_bytes ? memcmp(again, data, 8) != 0 : !same(GDS::bytesToDouble(again), value))
+        fail("round trip", again, value);
+}
+
+static void checkEncode(double value, const Byte *expected, const std::string &what)
+{
+    Byte data[8];
+    GDS::doubleToBytes(value, data);
+    if (memcmp(data, expected, 8) != 0)
+        fail(what, data, value);
+}
+
+/*
+ * Every exponent with both signs and the edge fractions.
+ **/
+static void testExponents()
+{
+    const unsigned long long min_normalized = 1ULL << 52;       // Leading hex digit 1.
+    const unsigned long long max_exact = ((1ULL << 53) - 1) << 3;   // 53 bits, the most a double holds.
+    const unsigned long long max_fraction = (1ULL << 56) - 1;
+
+    for (int exponent = 0; exponent < 128; exponent++)
+    {
+        for (int negative = 0; negative < 2; negative++)
+        {
+            double sign = negative ? -1.0 : 1.0;
+            int binary = 4 * (exponent - 64);
+            Byte data[8];
+
+            // A zero fraction is zero whatever the exponent, and comes back
+            // as the canonical zero.
+            makeReal(negative != 0, exponent, 0, data);
+            checkReal(data, sign * 0.0, exponent == 0);
+
+            makeReal(negative != 0, exponent, min_normalized, data);
+            checkReal(data, sign * ldexp(1.0, binary - 4), true);
+
+            makeReal(negative != 0, exponent, max_exact, data);
+            checkReal(data, sign * ldexp((double)((1ULL << 53) - 1), binary - 53), true);
+
+            // 56 bits round to the next power of 16, which is above the
+            // range for the largest exponent and saturates back to it.
+            makeReal(negative != 0, exponent, max_fraction, data);
+            checkReal(data, sign * ldexp(1.0, binary), exponent == 127);
+
+            // Denormalized fractions are read as well.
+            makeReal(negative != 0, exponent, 1, data);
+            checkReal(data, sign * ldexp(1.0, binary - 56), false);
+        }
+    }
+}
+
+/*
+ * Doubles outside the range of GDSII reals.
+ **/
+static void testLimits()
+{
+    for (int negative = 0; negative < 2; negative++)
+    {
+        double sign = negative ? -1.0 : 1.0;
+        Byte zero[8], largest[8], smallest[8];
+        makeReal(negative != 0, 0, 0, zero);
+        makeReal(negative != 0, 127, (1ULL << 56) - 1, largest);
+        makeReal(negative != 0, 0, 1, smallest);
+
+        // Subnormal doubles and everything below 16^-64 * 2^-56 flush to zero.
+        checkEncode(sign * std::numeric_limits<double>::denorm_min(), zero, "denormal");
+        checkEncode(sign * DBL_MIN / 2, zero, "denormal");
+        checkEncode(sign * DBL_MIN, zero, "underflow");
+        checkEncode(sign * ldexp(1.0, -313), zero, "underflow");
+        checkEncode(sign * ldexp(1.0, -312), smallest, "smallest");
+
+        // Doubles from 16^63 up saturate to the largest GDSII real.
+        checkEncode(sign * ldexp(1.0, 252), largest, "overflow");
+        checkEncode(sign * 1e300, largest, "overflow");
+        checkEncode(sign * DBL_MAX, largest, "overflow");
+        checkEncode(sign * std::numeric_limits<double>::infinity(), largest, "infinity");
+    }
+    Byte largest[8];
+    makeReal(false, 127, (1ULL << 56) - 1, largest);
+    checkEncode(std::numeric_limits<double>::quiet_NaN(), largest, "NaN");
+}
+
+/*
+ * Values found in real files.
+ **/
+static void testValues()
+{
+    const double values[] = {1.0, 0.001, 1e-9, 90.0, 180.0, 270.0, 2.5, 0.1, 1e-6, 123456.789, -45.0};
+    for (double value : values)
+    {
+        Byte data[8];
+        GDS::doubleToBytes(value, data);
+        if (!same(GDS::bytesToDouble(data), value))
+            fail("value", data, value);
+    }
+
+    // The user unit of most files, as written by other tools.
+    Byte expected[8] = {0x3e, 0x41, 0x89, 0x37, 0x4b, 0xc6, 0xa7, 0xf0};
+    checkEncode(0.001, expected, "0.001");
+}
+
+int main()
+{
+    testExponents();
+    testLimits();
+    testValues();
+    if (Failures > 0)
+    {
+        std::cout << Failures << " failures" << std::endl;
+        return 1;
+    }
+    std::cout << "all passed" << std::endl;
+    return 0;
+}
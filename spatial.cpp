@@ -0,0 +1,318 @@
+/*
+ * This file is part of GDSII.
+ *
+ * spatial.cpp -- The source file which defines the spatial index of the
+ *                shapes of a structure.
+ *
+ * Copyright (c) 2015 Kangpeng Shao <billowen035@gmail.com>
+ *
+ * GDSII is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at you option) any later version.
+ *
+ * GDSII is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABLILTY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GDSII. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+#include "spatial.h"
+#include "structures.h"
+
+namespace GDS
+{
+	static const size_t Node_capacity = 16;
+
+	// Twice the center, which keeps the comparisons in integers.
+	static long long centerX(const Box &box)
+	{
+		return (long long)box.x_min + box.x_max;
+	}
+
+	static long long centerY(const Box &box)
+	{
+		return (long long)box.y_min + box.y_max;
+	}
+
+	// Sort-Tile-Recursive order of boxes: vertical slices by x, each slice
+	// by y, so that runs of Node_capacity boxes are compact.
+	static void tileOrder(const std::vector<Box> &boxes, std::vector<unsigned> &order)
+	{
+		size_t n = boxes.size();
+		order.resize(n);
+		for (size_t i = 0; i < n; i++)
+			order[i] = (unsigned)i;
+		size_t nodes = (n + Node_capacity - 1) / Node_capacity;
+		size_t slices = (size_t)std::ceil(std::sqrt((double)nodes));
+		if (slices <= 1)
+		{
+			std::sort(order.begin(), order.end(), [&boxes](unsigned a, unsigned b)
+			{
+				return centerY(boxes[a]) < centerY(boxes[b]);
+			});
+			return;
+		}
+		std::sort(order.begin(), order.end(), [&boxes](unsigned a, unsigned b)
+		{
+			return centerX(boxes[a]) < centerX(boxes[b]);
+		});
+		size_t slice_size = (nodes + slices - 1) / slices * Node_capacity;
+		for (size_t first = 0; first < n; first += slice_size)
+		{
+			size_t last = std::min(n, first + slice_size);
+			std::sort(order.begin() + first, order.begin() + last, [&boxes](unsigned a, unsigned b)
+			{
+				return centerY(boxes[a]) < centerY(boxes[b]);
+			});
+		}
+	}
+
+	// Collects the boxes and elements of every layer. Trees are packed by
+	// finish().
+	struct SpatialBuilder : ElementVisitor
+	{
+		std::vector<LayerTree>              &Layers;
+		std::vector<Element*>               &References;
+		std::unordered_map<int, size_t>     Slots;      // (layer, datatype) to position in Layers.
+
+		SpatialBuilder(std::vector<LayerTree> &layers, std::vector<Element*> &references)
+			: Layers(layers), References(references) {}
+
+		void add(short layer, short data_type, const Box &box, Element *element)
+		{
+			int key = ((int)(unsigned short)layer << 16) | (unsigned short)data_type;
+			auto it = Slots.find(key);
+			if (it == Slots.end())
+			{
+				it = Slots.insert(std::make_pair(key, Layers.size())).first;
+				Layers.push_back(LayerTree(layer, data_type));
+			}
+			LayerTree &tree = Layers[it->second];
+			tree.Boxes.push_back(box);
+			tree.Items.push_back(element);
+		}
+
+		void boundary(Boundary &node)
+		{
+			add(node.layer(), node.dataType(), node.bbox(), &node);
+		}
+
+		void path(Path &node)
+		{
+			add(node.layer(), node.dataType(), node.bbox(), &node);
+		}
+
+		void text(Text &node)
+		{
+			add(node.layer(), node.textType(), node.bbox(), &node);
+		}
+
+		void sref(SRef &node)
+		{
+			References.push_back(&node);
+		}
+
+		void aref(ARef &node)
+		{
+			References.push_back(&node);
+		}
+
+		static void finish(LayerTree &tree)
+		{
+			// Shapes without vertices can never be found.
+			size_t kept = 0;
+			for (size_t i = 0; i < tree.Boxes.size(); i++)
+			{
+				if (tree.Boxes[i].empty())
+					continue;
+				tree.Boxes[kept] = tree.Boxes[i];
+				tree.Items[kept] = tree.Items[i];
+				kept++;
+			}
+			tree.Boxes.resize(kept);
+			tree.Items.resize(kept);
+			if (kept == 0)
+				return;
+
+			std::vector<unsigned> order;
+			tileOrder(tree.Boxes, order);
+			std::vector<Box> boxes(kept);
+			std::vector<Element*> items(kept);
+			for (size_t i = 0; i < kept; i++)
+			{
+				boxes[i] = tree.Boxes[order[i]];
+				items[i] = tree.Items[order[i]];
+			}
+			tree.Boxes.swap(boxes);
+			tree.Items.swap(items);
+
+			// Each level groups runs of the level below, which is put into
+			// tile order first.
+			std::vector<LayerTree::Node> &nodes = tree.Nodes;
+			for (size_t first = 0; first < kept; first += Node_capacity)
+			{
+				LayerTree::Node node;
+				node.First = (unsigned)first;
+				node.Count = (unsigned)std::min(Node_capacity, kept - first);
+				for (size_t i = first; i < first + node.Count; i++)
+					node.Bounds.add(tree.Boxes[i]);
+				nodes.push_back(node);
+			}
+			tree.Leaf_count = nodes.size();
+
+			size_t level = 0;
+			while (nodes.size() - level > 1)
+			{
+				size_t count = nodes.size() - level;
+				std::vector<Box> level_boxes(count);
+				for (size_t i = 0; i < count; i++)
+					level_boxes[i] = nodes[level + i].Bounds;
+				tileOrder(level_boxes, order);
+				std::vector<LayerTree::Node> sorted(count);
+				for (size_t i = 0; i < count; i++)
+					sorted[i] = nodes[level + order[i]];
+				std::copy(sorted.begin(), sorted.end(), nodes.begin() + level);
+
+				size_t next = nodes.size();
+				for (size_t first = 0; first < count; first += Node_capacity)
+				{
+					LayerTree::Node node;
+					node.First = (unsigned)(level + first);
+					node.Count = (unsigned)std::min(Node_capacity, count - first);
+					for (size_t i = node.First; i < node.First + node.Count; i++)
+						node.Bounds.add(nodes[i].Bounds);
+					nodes.push_back(node);
+				}
+				level = next;
+			}
+		}
+	};
+
+	LayerTree::LayerTree(short layer, short data_type)
+	{
+		Layer = layer;
+		Data_type = data_type;
+		Leaf_count = 0;
+	}
+
+	short LayerTree::layer() const
+	{
+		return Layer;
+	}
+
+	short LayerTree::dataType() const
+	{
+		return Data_type;
+	}
+
+	size_t LayerTree::size() const
+	{
+		return Items.size();
+	}
+
+	Box LayerTree::bounds() const
+	{
+		if (Nodes.empty())
+			return Box();
+		return Nodes.back().Bounds;
+	}
+
+	size_t LayerTree::query(const Box &window, std::vector<Element*> &result) const
+	{
+		if (Nodes.empty() || !Nodes.back().Bounds.overlaps(window))
+			return 0;
+		size_t found = result.size();
+		// The tree is at most a few levels deep, so the stack stays small.
+		unsigned stack[64 * Node_capacity];
+		size_t top = 0;
+		stack[top++] = (unsigned)(Nodes.size() - 1);
+		while (top > 0)
+		{
+			unsigned index = stack[--top];
+			const Node &node = Nodes[index];
+			if (index < Leaf_count)
+			{
+				for (unsigned i = node.First; i < node.First + node.Count; i++)
+				{
+					if (Boxes[i].overlaps(window))
+						result.push_back(Items[i]);
+				}
+				continue;
+			}
+			for (unsigned i = node.First; i < node.First + node.Count; i++)
+			{
+				if (Nodes[i].Bounds.overlaps(window))
+					stack[top++] = i;
+			}
+		}
+		return result.size() - found;
+	}
+
+	void SpatialIndex::build(Structure *structure)
+	{
+		Layers.clear();
+		References.clear();
+
+		SpatialBuilder builder(Layers, References);
+		structure->visit(builder);
+		for (LayerTree &tree : Layers)
+			SpatialBuilder::finish(tree);
+
+		std::sort(Layers.begin(), Layers.end(), [](const LayerTree &a, const LayerTree &b)
+		{
+			if (a.Layer != b.Layer)
+				return a.Layer < b.Layer;
+			return a.Data_type < b.Data_type;
+		});
+	}
+
+	void SpatialIndex::clear()
+	{
+		Layers.clear();
+		References.clear();
+	}
+
+	size_t SpatialIndex::size() const
+	{
+		return Layers.size();
+	}
+
+	const LayerTree& SpatialIndex::get(size_t index) const
+	{
+		return Layers[index];
+	}
+
+	const LayerTree* SpatialIndex::find(short layer, short data_type) const
+	{
+		auto it = std::lower_bound(Layers.begin(), Layers.end(), std::make_pair(layer, data_type),
+			[](const LayerTree &a, const std::pair<short, short> &key)
+		{
+			if (a.Layer != key.first)
+				return a.Layer < key.first;
+			return a.Data_type < key.second;
+		});
+		if (it == Layers.end() || it->Layer != layer || it->Data_type != data_type)
+			return nullptr;
+		return &*it;
+	}
+
+	size_t SpatialIndex::query(short layer, short data_type, const Box &window, std::vector<Element*> &result) const
+	{
+		const LayerTree *tree = find(layer, data_type);
+		if (tree == nullptr)
+			return 0;
+		return tree->query(window, result);
+	}
+
+	const std::vector<Element*>& SpatialIndex::references() const
+	{
+		return References;
+	}
+}
@@ -0,0 +1,124 @@
+/*
+ * This file is part of GDSII.
+ *
+ * spatial.h -- The header file which declare the spatial index of the
+ *              shapes of a structure.
+ *
+ * Copyright (c) 2015 Kangpeng Shao <billowen035@gmail.com>
+ *
+ * GDSII is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at you option) any later version.
+ *
+ * GDSII is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABLILTY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GDSII. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef GDS_SPATIAL_H
+#define GDS_SPATIAL_H
+
+#include <cstddef>
+#include <vector>
+#include "geometry.h"
+
+namespace GDS
+{
+	class Element;
+	class Structure;
+	struct SpatialBuilder;
+
+	/*!
+	 * \brief Packed R-tree of the shapes of one (layer, datatype).
+	 *
+	 * The tree is bulk loaded with Sort-Tile-Recursive packing: the boxes
+	 * are sorted into vertical slices by x, each slice is sorted by y and
+	 * cut into full nodes, and the nodes are packed the same way level by
+	 * level. Each node holds up to 16 children. The tree is never modified
+	 * after it is built.
+	 */
+	class LayerTree
+	{
+		friend class SpatialIndex;
+		friend struct SpatialBuilder;
+
+		struct Node
+		{
+			Box         Bounds;
+			unsigned    First;      //< First child, an item for leaves.
+			unsigned    Count;
+		};
+
+		short                   Layer;
+		short                   Data_type;
+		std::vector<Box>        Boxes;      //< Box of each item.
+		std::vector<Element*>   Items;      //< In packed order.
+		std::vector<Node>       Nodes;      //< Leaves first, the root last.
+		size_t                  Leaf_count;
+
+	public:
+		LayerTree(short layer = 0, short data_type = 0);
+
+		short layer() const;
+		short dataType() const;
+		size_t size() const;
+		/*!
+		 * Box of all shapes of the layer.
+		 */
+		Box bounds() const;
+
+		/*!
+		 * \brief Find the shapes whose box intersects a window.
+		 *
+		 * Boxes which touch the window on its border count. The shapes are
+		 * appended to the result in no particular order.
+		 *
+		 * \return	The number of shapes found.
+		 */
+		size_t query(const Box &window, std::vector<Element*> &result) const;
+	};
+
+	/*!
+	 * \brief Window queries over the boundaries, paths and texts of a
+	 * structure, one R-tree per (layer, datatype).
+	 *
+	 * Paths are indexed with their width and end extensions, texts with
+	 * their origin and TEXTTYPE. It is built by Structure::spatial() and
+	 * dropped whenever the structure or one of its elements changes.
+	 * References are not expanded; they are only listed, since their boxes
+	 * change with the referenced structures.
+	 */
+	class SpatialIndex
+	{
+		std::vector<LayerTree>      Layers;     //< Ordered by layer, then datatype.
+		std::vector<Element*>       References; //< SREF and AREF elements, in order.
+
+	public:
+		void build(Structure *structure);
+		void clear();
+
+		size_t size() const;
+		const LayerTree& get(size_t index) const;
+		/*!
+		 * \return	nullptr if the structure has no shape on the layer.
+		 */
+		const LayerTree* find(short layer, short data_type) const;
+		/*!
+		 * \brief Find the shapes of a layer whose box intersects a window.
+		 *
+		 * \return	The number of shapes appended to the result.
+		 */
+		size_t query(short layer, short data_type, const Box &window, std::vector<Element*> &result) const;
+		/*!
+		 * The SREF and AREF elements of the structure.
+		 */
+		const std::vector<Element*>& references() const;
+	};
+}
+
+#endif
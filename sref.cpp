@@ -25,6 +25,7 @@
 #include <sstream>
 #include "log.h"
 #include "gdsio.h"
+#include "stringtable.h"
 #include "library.h"
 #include "structures.h"
 
@@ -34,19 +35,25 @@ namespace GDS
 	SRef::SRef(Structure* parent) :Element(SREF, parent)
 	{
 		Eflags = 0;
-		SName = "";
+		SName = 0;
+		Target = nullptr;
 		Strans = 0;
 		Angle = 0;
 		Mag = 1;
 	}
 
+	void SRef::place()
+	{
+		Placement = Transform(X, Y, Angle, Mag, (Strans & REFLECTION) != 0);
+	}
+
 	SRef::~SRef()
 	{
 	}
 
 	std::string SRef::structName() const
 	{
-		return SName;
+		return internedString(SName);
 	}
 
 	void SRef::xy(int &x, int &y) const
@@ -75,48 +82,85 @@ namespace GDS
 		return Strans & flag;
 	}
 
+	const Transform& SRef::transform() const
+	{
+		return Placement;
+	}
+
+	StringId SRef::structNameId() const
+	{
+		return SName;
+	}
+
 	void SRef::setStructName(std::string name)
 	{
-		SName = name;
+		SName = internString(name);
+		Target = nullptr;
+		if (parent() != nullptr && parent()->library() != nullptr)
+			parent()->library()->link(this);
+		touch();
+	}
+
+	Structure* SRef::target() const
+	{
+		return Target != nullptr ? *Target : nullptr;
+	}
+
+	void SRef::setTarget(Structure* const* slot)
+	{
+		Target = slot;
 	}
 
 	void SRef::setXY(int x, int y)
 	{
 		X = x;
 		Y = y;
+		place();
+		touch();
 	}
 
 	void SRef::setAngle(double angle)
 	{
 		Angle = angle;
+		place();
+		touch();
 	}
 
 	void SRef::setMag(double mag)
 	{
 		Mag = mag;
+		place();
+		touch();
 	}
 
 	void SRef::setStrans(short strans)
 	{
 		Strans = strans;
+		place();
+		touch();
 	}
 
 	void SRef::setStrans(STRANS_FLAG flag, bool enable)
 	{
 		Strans = enable ? (Strans | flag) : (Strans & (~flag));
+		place();
+		touch();
 	}
 
-	bool SRef::read(std::ifstream &in)
+	bool SRef::read(RecordReader &reader)
 	{
 #ifdef _DEBUG_LOG
 		LogIO* log = LogIO::getInstance();
 #endif
+		const Record &rec = reader.record();
 		bool finished = false;
 		while (!finished)
 		{
-			short record_size = readShort(in);
-			Byte record_type = readByte(in);
-			Byte data_type = readByte(in);
+			if (!reader.next())
+				throw FormatError("unexpected end of file in SREF.");
+			int record_size = rec.size;
+			Byte record_type = rec.record_type;
+			Byte data_type = rec.data_type;
 			switch (record_type)
 			{
 			case ENDEL:
@@ -128,6 +172,7 @@ namespace GDS
 				}
 #endif
 				finished = true;
+				place();
 				break;
 			case EFLAGS:
 				if (record_size != 6)
@@ -139,7 +184,7 @@ namespace GDS
 					std::string msg = ss.str();
 					throw FormatError(msg);
 				}
-				Eflags = readShort(in);
+				Eflags = rec.getShort();
 #ifdef _DEBUG_LOG
 				{
 					std::stringstream ss;
@@ -158,11 +203,11 @@ namespace GDS
 					std::string msg = ss.str();
 					throw FormatError(msg);
 				}
-				SName = readString(in, record_size - 4);
+				SName = internString(rec.getString());
 #ifdef _DEBUG_LOG
 				{
 					std::stringstream ss;
-					ss << std::dec << " " << record_size << " " << Record_name[record_type] << " " << data_type << " " << SName << std::endl;
+					ss << std::dec << " " << record_size << " " << Record_name[record_type] << " " << data_type << " " << internedString(SName) << std::endl;
 					log->write(ss.str());
 				}
 #endif
@@ -177,8 +222,8 @@ namespace GDS
 					std::string msg = ss.str();
 					throw FormatError(msg);
 				}
-				X = readInteger(in);
-				Y = readInteger(in);
+				X = rec.getInteger(0);
+				Y = rec.getInteger(1);
 #ifdef _DEBUG_LOG
 				{
 					std::stringstream ss;
@@ -197,7 +242,7 @@ namespace GDS
 					std::string msg = ss.str();
 					throw FormatError(msg);
 				}
-				Strans = readShort(in);
+				Strans = rec.getShort();
 #ifdef _DEBUG_LOG
 				{
 					std::stringstream ss;
@@ -216,7 +261,7 @@ namespace GDS
 					std::string msg = ss.str();
 					throw FormatError(msg);
 				}
-				Mag = readDouble(in);
+				Mag = rec.getDouble();
 #ifdef _DEBUG_LOG
 				{
 					std::stringstream ss;
@@ -235,7 +280,7 @@ namespace GDS
 					std::string msg = ss.str();
 					throw FormatError(msg);
 				}
-				Angle = readDouble(in);
+				Angle = rec.getDouble();
 #ifdef _DEBUG_LOG
 				{
 					std::stringstream ss;
@@ -251,58 +296,16 @@ namespace GDS
 		return true;
 	}
 
-	bool SRef::write(std::ofstream &out)
+	bool SRef::write(RecordWriter &writer)
 	{
-		short record_size;
-
-		record_size = 4;
-		writeShort(out, record_size);
-		writeByte(out, SREF);
-		writeByte(out, NoData);
-
-		record_size = 6;
-		writeShort(out, record_size);
-		writeByte(out, EFLAGS);
-		writeByte(out, Integer_2);
-		writeShort(out, Eflags);
-
-		record_size = 6;
-		writeShort(out, record_size);
-		writeByte(out, STRANS);
-		writeByte(out, Integer_2);
-		writeShort(out, Strans);
-
-		record_size = 4 + SName.size();
-		if (record_size % 2 != 0)
-			record_size += 1;
-		writeShort(out, record_size);
-		writeByte(out, SNAME);
-		writeByte(out, String);
-		writeString(out, SName);
-
-		record_size = 12;
-		writeShort(out, record_size);
-		writeByte(out, XY);
-		writeByte(out, Integer_4);
-		writeInteger(out, X);
-		writeInteger(out, Y);
-
-		record_size = 12;
-		writeShort(out, record_size);
-		writeByte(out, ANGLE);
-		writeByte(out, Real_8);
-		writeDouble(out, Angle);
-
-		record_size = 12;
-		writeShort(out, record_size);
-		writeByte(out, MAG);
-		writeByte(out, Real_8);
-		writeDouble(out, Mag);
-
-		record_size = 4;
-		writeShort(out, record_size);
-		writeByte(out, ENDEL);
-		writeByte(out, NoData);
+		writer.writeRecord(SREF);
+		writer.writeShort(EFLAGS, Eflags);
+		writer.writeShort(STRANS, Strans);
+		writer.writeString(SNAME, internedString(SName));
+		writer.writeXY(&X, &Y, 1);
+		writer.writeDouble(ANGLE, Angle);
+		writer.writeDouble(MAG, Mag);
+		writer.writeRecord(ENDEL);
 
 		return true;
 	}
@@ -311,7 +314,7 @@ namespace GDS
 	{
 		out << "SREF" << std::endl;
 		out << "EFLAGS " << Eflags << std::endl;
-		out << "SNAME " << SName << std::endl;
+		out << "SNAME " << internedString(SName) << std::endl;
 		out << "STRANS " << Strans << std::endl;
 		out << "XY " << X << " " << Y << std::endl;
 		out << "ANGLE " << Angle << std::endl;
@@ -22,6 +22,8 @@
 #ifndef SREF_H
 #define SREF_H
 #include "elements.h"
+#include "stringtable.h"
+#include "geometry.h"
 
 namespace GDS {
 	class Structure;
@@ -40,32 +42,56 @@ namespace GDS {
 	 */
 	class SRef : public Element {
 		short               Eflags;
-		std::string         SName;
+		StringId            SName;
+		Structure* const*   Target;         //< Slot of the referenced structure in its library.
 		short               Strans;
 		int                 X, Y;
 		double              Angle;
 		double              Mag;
+		Transform           Placement;      //< Kept up to date with the fields above.
+
+		void place();
 
 	public:
 		SRef(Structure *parent = nullptr);
 		virtual ~SRef();
 
 		std::string structName() const;
+		StringId structNameId() const;
+		/*!
+		 * \brief The referenced structure.
+		 *
+		 * The reference is resolved when it is linked into a library, see
+		 * Library::link(). It follows later Library::add() and Library::del()
+		 * calls of the same name.
+		 *
+		 * \return	nullptr if the reference is not linked or the library has
+		 *			no structure of that name.
+		 */
+		Structure* target() const;
 		void xy(int &x, int &y) const;
 		double angle() const;
 		double mag() const;
 		short strans() const;
 		bool stransFlag(STRANS_FLAG flag) const;
+		/*!
+		 * \brief Placement of the referenced structure.
+		 *
+		 * The ABS_MAG and ABS_ANGLE flags are not taken into account. The
+		 * transform is built once when the element is read or changed.
+		 */
+		const Transform& transform() const;
 
 		void setStructName(std::string name);
+		void setTarget(Structure* const* slot);
 		void setXY(int x, int y);
 		void setAngle(double angle);
 		void setMag(double mag);
 		void setStrans(short strans);
 		void setStrans(STRANS_FLAG flag, bool enable = true);
 
-		virtual bool read(std::ifstream &in);
-		virtual bool write(std::ofstream &out);
+		virtual bool read(RecordReader &reader);
+		virtual bool write(RecordWriter &writer);
 		virtual bool printASCII(std::ofstream &out);
 	};
 
@@ -0,0 +1,106 @@
+/*
+ * This file is part of GDSII.
+ *
+ * stringtable.cpp -- The source file which defines the table of interned
+ *                    strings shared by all libraries.
+ *
+ * Copyright (c) 2015 Kangpeng Shao <billowen035@gmail.com>
+ *
+ * GDSII is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at you option) any later version.
+ *
+ * GDSII is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABLILTY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GDSII. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#include <functional>
+#include <stdexcept>
+#include "stringtable.h"
+
+namespace GDS
+{
+	StringTable::StringTable()
+	{
+		for (int i = 0; i < Page_count; i++)
+			Pages[i] = nullptr;
+		Next = 0;
+		intern("");
+	}
+
+	StringTable::~StringTable()
+	{
+		for (int i = 0; i < Page_count; i++)
+			delete[] Pages[i].load();
+	}
+
+	StringTable* StringTable::getInstance()
+	{
+		static StringTable instance;
+		return &instance;
+	}
+
+	StringId StringTable::intern(const std::string &str)
+	{
+		Shard &shard = Shards[std::hash<std::string>()(str) % Shard_count];
+		std::lock_guard<std::mutex> lock(shard.Mutex);
+
+		auto it = shard.Ids.find(str);
+		if (it != shard.Ids.end())
+			return it->second;
+
+		StringId id = Next++;
+		int page = id >> Page_bits;
+		if (page >= Page_count)
+			throw std::length_error("too many distinct strings.");
+		if (Pages[page].load() == nullptr)
+		{
+			std::lock_guard<std::mutex> page_lock(Page_mutex);
+			if (Pages[page].load() == nullptr)
+				Pages[page] = new const std::string*[1 << Page_bits];
+		}
+
+		// The keys of an unordered_map never move, so the table can point to them.
+		it = shard.Ids.insert(std::make_pair(str, id)).first;
+		Pages[page].load()[id & ((1 << Page_bits) - 1)] = &it->first;
+		return id;
+	}
+
+	bool StringTable::find(const std::string &str, StringId &id)
+	{
+		Shard &shard = Shards[std::hash<std::string>()(str) % Shard_count];
+		std::lock_guard<std::mutex> lock(shard.Mutex);
+
+		auto it = shard.Ids.find(str);
+		if (it == shard.Ids.end())
+			return false;
+		id = it->second;
+		return true;
+	}
+
+	const std::string& StringTable::get(StringId id) const
+	{
+		return *Pages[id >> Page_bits].load()[id & ((1 << Page_bits) - 1)];
+	}
+
+	size_t StringTable::size() const
+	{
+		return Next.load();
+	}
+
+	StringId internString(const std::string &str)
+	{
+		return StringTable::getInstance()->intern(str);
+	}
+
+	const std::string& internedString(StringId id)
+	{
+		return StringTable::getInstance()->get(id);
+	}
+}
@@ -0,0 +1,99 @@
+/*
+ * This file is part of GDSII.
+ *
+ * stringtable.h -- The header file which declare the table of interned
+ *                  strings shared by all libraries.
+ *
+ * Copyright (c) 2015 Kangpeng Shao <billowen035@gmail.com>
+ *
+ * GDSII is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at you option) any later version.
+ *
+ * GDSII is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABLILTY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GDSII. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef GDS_STRINGTABLE_H
+#define GDS_STRINGTABLE_H
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace GDS
+{
+	/*!
+	 * Handle of an interned string. Equal strings have equal handles, and the
+	 * handle 0 is the empty string.
+	 */
+	typedef unsigned int StringId;
+
+	/*!
+	 * \brief Table which stores every distinct string once.
+	 *
+	 * Structure names, SNAME references and TEXT strings are kept as
+	 * StringId handles, so comparing two names is an integer compare. The
+	 * table is thread-safe: interning goes through one of several locked
+	 * shards, and looking up a handle takes no lock.
+	 *
+	 * Strings are never removed and handles are never reused, so a handle
+	 * stays valid for the whole process, whoever holds it. A process which
+	 * reads many files one after another keeps the distinct strings of all
+	 * of them.
+	 *
+	 * The table holds at most Page_count * 2^Page_bits (2^28) distinct
+	 * strings; intern() throws std::length_error beyond that.
+	 */
+	class StringTable
+	{
+		static const int    Shard_count = 32;
+		static const int    Page_bits = 16;
+		static const int    Page_count = 4096;
+
+		struct Shard
+		{
+			std::mutex                                  Mutex;
+			std::unordered_map<std::string, StringId>   Ids;
+		};
+
+		Shard                               Shards[Shard_count];
+		std::atomic<const std::string**>    Pages[Page_count];     //< Handle to string, by pages.
+		std::atomic<StringId>               Next;
+		std::mutex                          Page_mutex;
+
+		StringTable();
+		StringTable(const StringTable&);
+		StringTable& operator=(const StringTable&);
+
+	public:
+		~StringTable();
+
+		static StringTable* getInstance();
+
+		StringId intern(const std::string &str);
+		/*!
+		 * Look up a string without adding it.
+		 *
+		 * \return	false if the string has never been interned.
+		 */
+		bool find(const std::string &str, StringId &id);
+		const std::string& get(StringId id) const;
+		size_t size() const;
+	};
+
+	/*
+	 * Shortcuts to the shared table.
+	 **/
+	StringId internString(const std::string &str);
+	const std::string& internedString(StringId id);
+}
+
+#endif
@@ -32,14 +32,20 @@
 #include "exceptions.h"
 #include "log.h"
 #include "gdsio.h"
+#include "stringtable.h"
+#include "library.h"
 #include <ctime>
+#include <unordered_map>
+#include <unordered_set>
+#include <cmath>
+#include <cstring>
 
 namespace GDS
 {
 
 	Structure::Structure()
 	{
-		Struct_name = "";
+		Struct_name = 0;
 
 		time_t now = time(0);
 		tm *ltm = localtime(&now);
@@ -55,11 +61,24 @@ namespace GDS
 		Acc_hour = ltm->tm_hour + 1;
 		Acc_minute = ltm->tm_min + 1;
 		Acc_second = ltm->tm_sec + 1;
+
+		Source = nullptr;
+		Source_length = 0;
+		Source_offset = 0;
+		Owner = nullptr;
+		Storage = new Arena();
+		Layer_store_valid = false;
+		Spatial_index_valid = false;
+		Bbox_epoch = 0;
+		Bbox_busy = false;
+		Content_hash = 0;
+		Hash_epoch = 0;
+		Hash_busy = false;
 	}
 
 	Structure::Structure(std::string name)
 	{
-		Struct_name = name;
+		Struct_name = internString(name);
 
 		time_t now = time(0);
 		tm *ltm = localtime(&now);
@@ -75,6 +94,19 @@ namespace GDS
 		Acc_hour = ltm->tm_hour + 1;
 		Acc_minute = ltm->tm_min + 1;
 		Acc_second = ltm->tm_sec + 1;
+
+		Source = nullptr;
+		Source_length = 0;
+		Source_offset = 0;
+		Owner = nullptr;
+		Storage = new Arena();
+		Layer_store_valid = false;
+		Spatial_index_valid = false;
+		Bbox_epoch = 0;
+		Bbox_busy = false;
+		Content_hash = 0;
+		Hash_epoch = 0;
+		Hash_busy = false;
 	}
 
 	Structure::~Structure()
@@ -82,18 +114,85 @@ namespace GDS
         for (size_t i = 0; i < Contents.size(); i++)
         {
             if (Contents[i] != nullptr)
+            {
+                // Detached first, so the element does not search for itself.
+                Contents[i]->setParent(nullptr);
                 delete Contents[i];
+            }
         }
 		Contents.clear();
+		Storage->release();
 	}
 
 	std::string Structure::name() const
+	{
+		return internedString(Struct_name);
+	}
+
+	StringId Structure::nameId() const
 	{
 		return Struct_name;
 	}
 
+	void Structure::setName(std::string name)
+	{
+		// The parents are found by the old name.
+		touch();
+		Struct_name = internString(name);
+	}
+
+	Arena* Structure::arena() const
+	{
+		return Storage;
+	}
+
+	void Structure::setArena(Arena *arena)
+	{
+		arena->retain();
+		Storage->release();
+		Storage = arena;
+	}
+
+	Library* Structure::library() const
+	{
+		return Owner;
+	}
+
+	void Structure::setLibrary(Library *library)
+	{
+		if (Owner != nullptr && Owner != library)
+			Owner->removeReferrer(this);
+		Owner = library;
+		// The references may resolve differently in the new library.
+		Bbox_epoch = 0;
+		Hash_epoch = 0;
+	}
+
+	struct ChildCollector : ElementVisitor
+	{
+		std::vector<Structure*>         Result;
+		std::unordered_set<Structure*>  Seen;
+
+		void add(Structure *child)
+		{
+			if (child != nullptr && Seen.insert(child).second)
+				Result.push_back(child);
+		}
+
+		void sref(SRef &node) { add(node.target()); }
+		void aref(ARef &node) { add(node.target()); }
+	};
+
+	std::vector<Structure*> Structure::children()
+	{
+		ChildCollector collector;
+		visit(collector);
+		return collector.Result;
+	}
+
 	size_t Structure::size()
 	{
+		load();
 		for (int i = (int)Contents.size() - 1; i >= 0; i--)
 		{
 			if (Contents[i] == nullptr)
@@ -104,6 +203,7 @@ namespace GDS
 
 	Element* Structure::get(int index) const
 	{
+		const_cast<Structure*>(this)->load();
 		if (index < 0 || index >= Contents.size())
 			return nullptr;
 		else
@@ -114,10 +214,14 @@ namespace GDS
 	{
 		if (e == nullptr)
 			return;
+		load();
 		if (find(Contents.begin(), Contents.end(), e) == Contents.end())
 		{
 			e->setParent(this);
 			Contents.push_back(e);
+			if (Owner != nullptr)
+				Owner->link(e);
+			touch();
 			
 		}
 			
@@ -125,29 +229,457 @@ namespace GDS
 
 	void Structure::set(int index, Element* e)
 	{
+		load();
 		if (index < 0 || index >= Contents.size())
 			return;
 		Contents[index] = e;
+		if (e != nullptr && Owner != nullptr)
+			Owner->link(e);
+		touch();
+	}
+
+	// The cached box and hash are stamped with the link epoch of the
+	// library, which changes when a name is bound to another structure.
+	unsigned long Structure::linkEpoch() const
+	{
+		return Owner != nullptr ? Owner->Link_epoch : 1;
+	}
+
+	void Structure::invalidate()
+	{
+		// Caching the data of a structure caches that of its children
+		// first, so the parents of a structure without cached data have
+		// none either.
+		if (Bbox_epoch == 0 && Hash_epoch == 0)
+			return;
+		Bbox_epoch = 0;
+		Hash_epoch = 0;
+		if (Owner == nullptr)
+			return;
+		auto it = Owner->Referrers.find(Struct_name);
+		if (it == Owner->Referrers.end())
+			return;
+		for (Structure *node : it->second)
+			node->invalidate();
+	}
+
+	void Structure::touch()
+	{
+		if (Layer_store_valid)
+		{
+			Layer_store.clear();
+			Layer_store_valid = false;
+		}
+		if (Spatial_index_valid)
+		{
+			Spatial_index.clear();
+			Spatial_index_valid = false;
+		}
+		invalidate();
+	}
+
+	struct BoxCollector : ElementVisitor
+	{
+		Box     Result;
+
+		void boundary(Boundary &node)
+		{
+			Result.add(node.bbox());
+		}
+
+		void path(Path &node)
+		{
+			Result.add(node.bbox());
+		}
+
+		void text(Text &node)
+		{
+			Result.add(node.bbox());
+		}
+
+		void sref(SRef &node)
+		{
+			Structure *child = node.target();
+			if (child == nullptr)
+				return;
+			Result.add(node.transform().apply(child->bbox()));
+		}
+
+		void aref(ARef &node)
+		{
+			Structure *child = node.target();
+			if (child == nullptr || node.col() <= 0 || node.row() <= 0)
+				return;
+			Box first = node.transform().apply(child->bbox());
+			if (first.empty())
+				return;
+			// The instances form a parallelogram, so the corner instances
+			// bound the array.
+			double col_x, col_y, row_x, row_y;
+			node.pitch(col_x, col_y, row_x, row_y);
+			int cols[2] = { 0, node.col() - 1 };
+			int rows[2] = { 0, node.row() - 1 };
+			for (int i = 0; i < 2; i++)
+			{
+				for (int j = 0; j < 2; j++)
+				{
+					double dx = cols[i] * col_x + rows[j] * row_x;
+					double dy = cols[i] * col_y + rows[j] * row_y;
+					Result.add(Box((int)std::floor(first.x_min + dx), (int)std::floor(first.y_min + dy),
+						(int)std::ceil(first.x_max + dx), (int)std::ceil(first.y_max + dy)));
+				}
+			}
+		}
+	};
+
+	Box elementBox(Element *e)
+	{
+		BoxCollector collector;
+		visitElement(collector, e);
+		return collector.Result;
 	}
 
-	bool Structure::read(std::ifstream &in)
+	Box Structure::bbox()
 	{
+		unsigned long epoch = linkEpoch();
+		if (Bbox_epoch == epoch)
+			return Bbox;
+		if (Bbox_busy)
+			return Box();
+
+		Bbox_busy = true;
+		BoxCollector collector;
+		visit(collector);
+		Bbox_busy = false;
+
+		Bbox = collector.Result;
+		Bbox_epoch = epoch;
+		return Bbox;
+	}
+
+	static unsigned long long mixHash(unsigned long long h)
+	{
+		h ^= h >> 30;
+		h *= 0xbf58476d1ce4e5b9ULL;
+		h ^= h >> 27;
+		h *= 0x94d049bb133111ebULL;
+		h ^= h >> 31;
+		return h;
+	}
+
+	// Hashes the fields of one element, in a fixed width and byte order
+	// independent form.
+	struct HashCollector : ElementVisitor
+	{
+		unsigned long long  Value;
+
+		HashCollector() : Value(0x9e3779b97f4a7c15ULL) {}
+
+		void add(unsigned long long v)
+		{
+			Value = mixHash(Value ^ (v + 0x9e3779b97f4a7c15ULL));
+		}
+
+		void add(double v)
+		{
+			// 0 and -0 are the same angle.
+			if (v == 0)
+				v = 0;
+			unsigned long long bits;
+			std::memcpy(&bits, &v, sizeof(bits));
+			add(bits);
+		}
+
+		void add(const std::string &s)
+		{
+			add((unsigned long long)s.size());
+			for (size_t i = 0; i < s.size(); i += 8)
+			{
+				unsigned long long chunk = 0;
+				for (size_t k = i; k < s.size() && k < i + 8; k++)
+					chunk |= (unsigned long long)(unsigned char)s[k] << (8 * (k - i));
+				add(chunk);
+			}
+		}
+
+		void add(short a, short b)
+		{
+			add(((unsigned long long)(unsigned short)a << 16) | (unsigned short)b);
+		}
+
+		void add(const int *x, const int *y, size_t count)
+		{
+			add((unsigned long long)count);
+			for (size_t i = 0; i < count; i++)
+				add(((unsigned long long)(unsigned)x[i] << 32) | (unsigned)y[i]);
+		}
+
+		void target(Structure *child, StringId name)
+		{
+			if (child != nullptr)
+				add(child->hash());
+			else
+				add(internedString(name));
+		}
+
+		void boundary(Boundary &node)
+		{
+			add((unsigned long long)BOUNDARY);
+			add(node.layer(), node.dataType());
+			add(node.xData(), node.yData(), node.pointCount());
+		}
+
+		void path(Path &node)
+		{
+			int begin, end;
+			node.extension(begin, end);
+			add((unsigned long long)PATH);
+			add(node.layer(), node.dataType());
+			add((unsigned long long)node.pathType());
+			add((unsigned long long)(unsigned)node.width());
+			add(((unsigned long long)(unsigned)begin << 32) | (unsigned)end);
+			add(node.xData(), node.yData(), node.pointCount());
+		}
+
+		void text(Text &node)
+		{
+			int x, y;
+			node.xy(x, y);
+			add((unsigned long long)TEXT);
+			add(node.layer(), node.textType());
+			add(node.presentation(), node.strans());
+			add(&x, &y, 1);
+			add(internedString(node.stringId()));
+		}
+
+		void sref(SRef &node)
+		{
+			int x, y;
+			node.xy(x, y);
+			add((unsigned long long)SREF);
+			target(node.target(), node.structNameId());
+			add((unsigned long long)(unsigned short)node.strans());
+			add(node.mag());
+			add(node.angle());
+			add(&x, &y, 1);
+		}
+
+		void aref(ARef &node)
+		{
+			std::vector<int> x, y;
+			node.xy(x, y);
+			add((unsigned long long)AREF);
+			target(node.target(), node.structNameId());
+			add((unsigned long long)(unsigned short)node.strans());
+			add(node.mag());
+			add(node.angle());
+			add(node.col(), node.row());
+			add(x.data(), y.data(), x.size());
+		}
+	};
+
+	unsigned long long elementHash(Element *e)
+	{
+		HashCollector collector;
+		visitElement(collector, e);
+		return collector.Value;
+	}
+
+	bool StructureComparer::equal(Structure *a, Structure *b)
+	{
+		if (a == b)
+			return true;
+		if (a == nullptr || b == nullptr)
+			return false;
+		std::pair<Structure*, Structure*> key(a, b);
+		auto known = Known.find(key);
+		if (known != Known.end())
+			return known->second;
+		Known[key] = true;
+
+		bool result = a->hash() == b->hash() && a->size() == b->size();
+		std::unordered_map<unsigned long long, std::vector<Element*> > left;
+		for (size_t i = 0; result && i < a->size(); i++)
+		{
+			Element *e = a->get((int)i);
+			if (e != nullptr)
+				left[elementHash(e)].push_back(e);
+		}
+		for (size_t i = 0; result && i < b->size(); i++)
+		{
+			Element *e = b->get((int)i);
+			if (e == nullptr)
+				continue;
+			std::vector<Element*> &candidates = left[elementHash(e)];
+			size_t k = 0;
+			while (k < candidates.size() && !equal(candidates[k], e))
+				k++;
+			if (k == candidates.size())
+			{
+				result = false;
+				break;
+			}
+			candidates[k] = candidates.back();
+			candidates.pop_back();
+		}
+		Known[key] = result;
+		return result;
+	}
+
+	bool StructureComparer::equalTargets(Structure *a, StringId a_name, Structure *b, StringId b_name)
+	{
+		if (a == nullptr && b == nullptr)
+			return a_name == b_name;
+		return equal(a, b);
+	}
+
+	bool StructureComparer::equal(Element *a, Element *b)
+	{
+		if (a == b)
+			return true;
+		if (a == nullptr || b == nullptr || a->tag() != b->tag())
+			return false;
+		switch (a->tag())
+		{
+		case BOUNDARY:
+		{
+			Boundary *p = static_cast<Boundary*>(a), *q = static_cast<Boundary*>(b);
+			size_t n = p->pointCount();
+			return p->layer() == q->layer() && p->dataType() == q->dataType() && n == q->pointCount()
+				&& std::equal(p->xData(), p->xData() + n, q->xData())
+				&& std::equal(p->yData(), p->yData() + n, q->yData());
+		}
+		case PATH:
+		{
+			Path *p = static_cast<Path*>(a), *q = static_cast<Path*>(b);
+			size_t n = p->pointCount();
+			int p_begin, p_end, q_begin, q_end;
+			p->extension(p_begin, p_end);
+			q->extension(q_begin, q_end);
+			return p->layer() == q->layer() && p->dataType() == q->dataType()
+				&& p->pathType() == q->pathType() && p->width() == q->width()
+				&& p_begin == q_begin && p_end == q_end && n == q->pointCount()
+				&& std::equal(p->xData(), p->xData() + n, q->xData())
+				&& std::equal(p->yData(), p->yData() + n, q->yData());
+		}
+		case TEXT:
+		{
+			Text *p = static_cast<Text*>(a), *q = static_cast<Text*>(b);
+			int px, py, qx, qy;
+			p->xy(px, py);
+			q->xy(qx, qy);
+			return p->layer() == q->layer() && p->textType() == q->textType()
+				&& p->presentation() == q->presentation() && p->strans() == q->strans()
+				&& px == qx && py == qy && p->stringId() == q->stringId();
+		}
+		case SREF:
+		{
+			SRef *p = static_cast<SRef*>(a), *q = static_cast<SRef*>(b);
+			int px, py, qx, qy;
+			p->xy(px, py);
+			q->xy(qx, qy);
+			return p->strans() == q->strans() && p->mag() == q->mag() && p->angle() == q->angle()
+				&& px == qx && py == qy
+				&& equalTargets(p->target(), p->structNameId(), q->target(), q->structNameId());
+		}
+		case AREF:
+		{
+			ARef *p = static_cast<ARef*>(a), *q = static_cast<ARef*>(b);
+			std::vector<int> px, py, qx, qy;
+			p->xy(px, py);
+			q->xy(qx, qy);
+			return p->strans() == q->strans() && p->mag() == q->mag() && p->angle() == q->angle()
+				&& p->col() == q->col() && p->row() == q->row() && px == qx && py == qy
+				&& equalTargets(p->target(), p->structNameId(), q->target(), q->structNameId());
+		}
+		default:
+			return false;
+		}
+	}
+
+	// Sums the element hashes, so the order of the elements does not
+	// count.
+	struct HashSummer : ElementVisitor
+	{
+		unsigned long long  Sum;
+		unsigned long long  Count;
+
+		HashSummer() : Sum(0), Count(0) {}
+
+		void add(Element &e)
+		{
+			Sum += elementHash(&e);
+			Count++;
+		}
+
+		void boundary(Boundary &node) { add(node); }
+		void path(Path &node) { add(node); }
+		void text(Text &node) { add(node); }
+		void sref(SRef &node) { add(node); }
+		void aref(ARef &node) { add(node); }
+	};
+
+	unsigned long long Structure::hash()
+	{
+		unsigned long epoch = linkEpoch();
+		if (Hash_epoch == epoch)
+			return Content_hash;
+		// A reference back into the structure hashes as an empty one.
+		if (Hash_busy)
+			return 0;
+
+		Hash_busy = true;
+		HashSummer summer;
+		visit(summer);
+		Hash_busy = false;
+
+		Content_hash = mixHash(summer.Sum ^ mixHash(summer.Count));
+		Hash_epoch = epoch;
+		return Content_hash;
+	}
+
+	const LayerStore& Structure::layers()
+	{
+		if (!Layer_store_valid)
+		{
+			Layer_store.build(this);
+			Layer_store_valid = true;
+		}
+		return Layer_store;
+	}
+
+	const SpatialIndex& Structure::spatial()
+	{
+		if (!Spatial_index_valid)
+		{
+			Spatial_index.build(this);
+			Spatial_index_valid = true;
+		}
+		return Spatial_index;
+	}
+
+	bool Structure::read(RecordReader &reader)
+	{
+		// A structure being loaded has no derived data yet.
+		if (!Contents.empty())
+			touch();
 #ifdef _DEBUG_LOG
         LogIO* log = LogIO::getInstance();
 #endif
 
-		Mod_year = readShort(in);
-		Mod_month = readShort(in);
-		Mod_day = readShort(in);
-		Mod_hour = readShort(in);
-		Mod_minute = readShort(in);
-		Mod_second = readShort(in);
-		Acc_year = readShort(in);
-		Acc_month = readShort(in);
-		Acc_day = readShort(in);
-		Acc_hour = readShort(in);
-		Acc_minute = readShort(in);
-		Acc_second = readShort(in);
+		const Record &rec = reader.record();
+		Mod_year = rec.getShort(0);
+		Mod_month = rec.getShort(1);
+		Mod_day = rec.getShort(2);
+		Mod_hour = rec.getShort(3);
+		Mod_minute = rec.getShort(4);
+		Mod_second = rec.getShort(5);
+		Acc_year = rec.getShort(6);
+		Acc_month = rec.getShort(7);
+		Acc_day = rec.getShort(8);
+		Acc_hour = rec.getShort(9);
+		Acc_minute = rec.getShort(10);
+		Acc_second = rec.getShort(11);
 
 #ifdef _DEBUG_LOG
         std::stringstream ss;
@@ -159,9 +691,11 @@ namespace GDS
 		bool finished = false;
 		while (!finished)
 		{
-			short record_size = readShort(in);
-			Byte record_type = readByte(in);
-			Byte data_type = readByte(in);
+			if (!reader.next())
+				throw FormatError("unexpected end of file in structure " + name() + ".");
+			int record_size = rec.size;
+			Byte record_type = rec.record_type;
+			Byte data_type = rec.data_type;
 			switch (record_type)
 			{
 			case ENDSTR:
@@ -193,12 +727,12 @@ namespace GDS
 					std::string msg = ss.str();
 					throw FormatError(msg);
 				}
-				Struct_name = readString(in, record_size - 4);
+				Struct_name = internString(rec.getString());
 #ifdef _DEBUG_LOG
                 {
                     std::stringstream ss;
                     ss << std::dec << " " << record_size << " " << Record_name[record_type] << " " << data_type;
-                    ss << " " << Struct_name << std::endl;
+                    ss << " " << name() << std::endl;
                     log->write(ss.str());
                 }
 #endif
@@ -221,8 +755,8 @@ namespace GDS
                     log->write(ss.str());
                 }
 #endif
-				Text *e = new Text(this);
-				e->read(in);
+				Text *e = new (Storage) Text(this);
+				e->read(reader);
 				Contents.push_back(e);
 				break;
 			}
@@ -244,8 +778,8 @@ namespace GDS
                     log->write(ss.str());
                 }
 #endif
-				Boundary *e = new Boundary(this);
-				e->read(in);
+				Boundary *e = new (Storage) Boundary(this);
+				e->read(reader);
 				Contents.push_back(e);
 				break;
 			}
@@ -267,8 +801,8 @@ namespace GDS
                     log->write(ss.str());
                 }
 #endif
-				Path *e = new Path(this);
-				e->read(in);
+				Path *e = new (Storage) Path(this);
+				e->read(reader);
 				Contents.push_back(e);
 				break;
 			}
@@ -290,8 +824,8 @@ namespace GDS
                     log->write(ss.str());
                 }
 #endif
-				SRef *e = new SRef(this);
-				e->read(in);
+				SRef *e = new (Storage) SRef(this);
+				e->read(reader);
 				Contents.push_back(e);
 				break;
 			}
@@ -313,8 +847,8 @@ namespace GDS
                     log->write(ss.str());
                 }
 #endif
-				ARef *e = new ARef(this);
-				e->read(in);
+				ARef *e = new (Storage) ARef(this);
+				e->read(reader);
 				Contents.push_back(e);
 				break;
 			}
@@ -325,50 +859,62 @@ namespace GDS
 		return true;
 	}
 
-	bool Structure::write(std::ofstream &out)
-	{
-		short record_size;
-
-		record_size = 28;
-		writeShort(out, record_size);
-		writeByte(out, BGNSTR);
-		writeByte(out, Integer_2);
-		writeShort(out, Mod_year);
-		writeShort(out, Mod_month);
-		writeShort(out, Mod_day);
-		writeShort(out, Mod_hour);
-		writeShort(out, Mod_minute);
-		writeShort(out, Mod_second);
-		writeShort(out, Acc_year);
-		writeShort(out, Acc_month);
-		writeShort(out, Acc_day);
-		writeShort(out, Acc_hour);
-		writeShort(out, Acc_minute);
-		writeShort(out, Acc_second);
-
-		record_size = 4 + Struct_name.size();
-		if (record_size % 2 != 0)
-			record_size += 1;
-		writeShort(out, record_size);
-		writeByte(out, STRNAME);
-		writeByte(out, String);
-		writeString(out, Struct_name);
+	void Structure::setSource(const Byte *data, size_t length, long long offset)
+	{
+		Source = data;
+		Source_length = length;
+		Source_offset = offset;
+	}
+
+	bool Structure::isLoaded() const
+	{
+		return Source == nullptr;
+	}
+
+	void Structure::load()
+	{
+		if (Source == nullptr)
+			return;
+		RecordReader reader(Source, Source_length, Source_offset);
+		// Leave room for all the elements in one block.
+		Storage->reserve(Source_length * 2);
+		Source = nullptr;
+		if (!reader.next() || reader.record().record_type != BGNSTR)
+			throw FormatError("missing BGNSTR in structure " + name() + ".");
+		read(reader);
+		if (Owner != nullptr)
+			Owner->link(this);
+	}
+
+	bool Structure::write(RecordWriter &writer)
+	{
+		// A structure which has never been touched goes out unchanged.
+		if (Source != nullptr)
+		{
+			writer.writeRaw(Source, Source_length);
+			return true;
+		}
+
+		short dates[12] = {
+			Mod_year, Mod_month, Mod_day, Mod_hour, Mod_minute, Mod_second,
+			Acc_year, Acc_month, Acc_day, Acc_hour, Acc_minute, Acc_second
+		};
+		writer.writeShorts(BGNSTR, dates, 12);
+		writer.writeString(STRNAME, internedString(Struct_name));
 
 		for (Element * e : Contents)
 		{
-			e->write(out);
+			e->write(writer);
 		}
 
-		record_size = 4;
-		writeShort(out, record_size);
-		writeByte(out, ENDSTR);
-		writeByte(out, NoData);
+		writer.writeRecord(ENDSTR);
 
 		return true;
 	}
 
 	bool Structure::printASCII(std::ofstream &out)
 	{
+		load();
 		out << "BGNSTR" << std::endl;
 		out << Mod_year << " "
 			<< Mod_month << " "
@@ -382,7 +928,7 @@ namespace GDS
 			<< Acc_hour << " "
 			<< Acc_minute << " "
 			<< Acc_second << std::endl;
-		out << "STRNAME " << Struct_name << std::endl;
+		out << "STRNAME " << name() << std::endl;
 		for (Element *e : Contents)
 		{
 			e->printASCII(out);
@@ -24,12 +24,27 @@
 #include <vector>
 #include <string>
 #include <fstream>
+#include <map>
+#include <unordered_set>
+#include <utility>
 #include "elements.h"
+#include "boundary.h"
+#include "path.h"
+#include "text.h"
+#include "sref.h"
+#include "aref.h"
+#include "stringtable.h"
+#include "layerstore.h"
+#include "spatial.h"
+#include "geometry.h"
 
 namespace GDS {
+	class RecordReader;
+	class RecordWriter;
+	class Library;
 
 	class Structure {
-		std::string     Struct_name;
+		StringId        Struct_name;
 		short           Mod_year;
 		short           Mod_month;
 		short           Mod_day;
@@ -44,23 +59,247 @@ namespace GDS {
 		short           Acc_second;
 
 		std::vector<Element*> Contents;
+
+		const Byte*     Source;         //< Unparsed BGNSTR .. ENDSTR block, nullptr once loaded.
+		size_t          Source_length;
+		long long       Source_offset;
+
+		Library*        Owner;          //< Library which links the references of the structure.
+		std::unordered_set<StringId> Referenced;   //< Names the owner lists the structure as a referrer of.
+		Arena*          Storage;        //< Memory of the elements read into the structure.
+
+		LayerStore      Layer_store;    //< Built on demand by layers().
+		bool            Layer_store_valid;
+		SpatialIndex    Spatial_index;  //< Built on demand by spatial().
+		bool            Spatial_index_valid;
+		Box             Bbox;
+		unsigned long   Bbox_epoch;     //< Link epoch Bbox was computed in, 0 if stale.
+		bool            Bbox_busy;      //< Guards against recursive references.
+		unsigned long long Content_hash;
+		unsigned long   Hash_epoch;     //< Link epoch Content_hash was computed in, 0 if stale.
+		bool            Hash_busy;
+
+		Structure(const Structure&);
+		Structure& operator=(const Structure&);
+
+		friend class Library;
+
+		unsigned long linkEpoch() const;
+		void invalidate();
 	public:
 		Structure();
 		Structure(std::string name);
 		~Structure();
 
 		std::string name() const;
+		StringId nameId() const;
+		/*!
+		 * \brief Rename the structure.
+		 *
+		 * References keep the name they have, and a library holding the
+		 * structure still finds it by the old one, so rename a structure
+		 * before it is added to a library.
+		 */
+		void setName(std::string name);
+		/*!
+		 * \brief The arena which holds the elements read into the structure.
+		 *
+		 * Elements created with new(structure->arena()) share it as well.
+		 */
+		Arena* arena() const;
+		/*!
+		 * \brief Share an arena with other structures.
+		 *
+		 * Readers give all the structures of a file one arena, which is
+		 * freed with the last of them. Elements already in the structure keep
+		 * their memory.
+		 */
+		void setArena(Arena *arena);
+		Library* library() const;
+		void setLibrary(Library *library);
+		/*!
+		 * \brief The structures referenced by SREF and AREF elements.
+		 *
+		 * Every structure is listed once, in order of its first reference.
+		 * References which are not resolved in the library are left out.
+		 */
+		std::vector<Structure*> children();
 		size_t size();
 		Element* get(int index) const;
+		/*!
+		 * \brief Call the visitor for every element, by its type.
+		 *
+		 * The element type is taken from its tag, so neither RTTI nor
+		 * virtual calls are involved.
+		 *
+		 * \param [in] visitor		An ElementVisitor, or any object with its functions.
+		 * \param [in] first		Position of the first element to visit.
+		 * \param [in] last		Position after the last element to visit.
+		 */
+		template<class Visitor>
+		void visit(Visitor &visitor, size_t first = 0, size_t last = (size_t)-1);
 
 		void add(Element* e);
 		void set(int index, Element* e);
+		/*!
+		 * \brief Drop the data derived from the contents.
+		 *
+		 * It is called by add(), set() and the setters of the elements, and
+		 * by the library when a structure is added or deleted. The cached
+		 * box and hash of the structures which reference it, directly or
+		 * not, are dropped as well, since they include its own. Caches of
+		 * other structures and other libraries are kept.
+		 */
+		void touch();
+		/*!
+		 * \brief Bounding box of the structure and everything it references.
+		 *
+		 * The boxes of the children are computed first and cached, so the
+		 * hierarchy is walked once. References are placed with their
+		 * reflection, magnification and angle; arrays are expanded from their
+		 * corner instances. Paths are padded by half their width and their
+		 * end extensions. The call is not thread-safe.
+		 *
+		 * \return	An empty box if the structure has no shapes.
+		 */
+		Box bbox();
+		/*!
+		 * \brief 64-bit hash of the contents of the structure.
+		 *
+		 * It covers the layers, datatypes and vertices of the shapes, the
+		 * settings of paths and texts, and the placements of references.
+		 * A reference counts with the hash of the structure it places
+		 * instead of its name, an unresolved one with its name. The name of
+		 * the structure, its dates and the order of its elements are left
+		 * out, so equal layouts hash alike in any library and in any run.
+		 *
+		 * The hash is cached like bbox(), and computed again after any
+		 * change. Hierarchy::computeHashes() fills the caches of a whole
+		 * library on several threads. The call is not thread-safe.
+		 */
+		unsigned long long hash();
+		/*!
+		 * \brief Shapes of the structure grouped by (layer, datatype).
+		 *
+		 * The store is built on the first call after a change and kept
+		 * until the next one. The call is not thread-safe.
+		 */
+		const LayerStore& layers();
+		/*!
+		 * \brief R-trees of the shapes of the structure by (layer, datatype).
+		 *
+		 * The trees are packed on the first call after the structure is read
+		 * or changed, and kept until the next change. Building is not
+		 * thread-safe; queries on a built index are.
+		 *
+		 * \code
+		 *  std::vector<Element*> found;
+		 *  structure->spatial().query(layer, data_type, Box(x0, y0, x1, y1), found);
+		 * \endcode
+		 */
+		const SpatialIndex& spatial();
 
-		bool read(std::ifstream &in);
-		bool write(std::ofstream &out);
+		/*!
+		 * \brief Read the structure from a record reader.
+		 *
+		 * The current record of the reader must be the BGNSTR record of the
+		 * structure. The call will throw some exceptions.
+		 */
+		bool read(RecordReader &reader);
+		/*!
+		 * \brief Defer reading the structure until its contents are used.
+		 *
+		 * The block must stay valid until the structure is loaded or destroyed.
+		 *
+		 * \param [in] data		The BGNSTR .. ENDSTR block of the structure.
+		 * \param [in] length		Size of the block.
+		 * \param [in] offset		File offset of the block, used in error messages.
+		 */
+		void setSource(const Byte *data, size_t length, long long offset);
+		bool isLoaded() const;
+		/*!
+		 * Parse the deferred block, if any. It is called implicitly by every
+		 * access to the contents. The call will throw some exceptions.
+		 */
+		void load();
+		bool write(RecordWriter &writer);
 		bool printASCII(std::ofstream &out);
 	};
 
+	/*!
+	 * \brief Call the function of the visitor for the type of one element.
+	 */
+	template<class Visitor>
+	void visitElement(Visitor &visitor, Element *e)
+	{
+		switch (e->tag())
+		{
+		case BOUNDARY:
+			visitor.boundary(*static_cast<Boundary*>(e));
+			break;
+		case PATH:
+			visitor.path(*static_cast<Path*>(e));
+			break;
+		case TEXT:
+			visitor.text(*static_cast<Text*>(e));
+			break;
+		case SREF:
+			visitor.sref(*static_cast<SRef*>(e));
+			break;
+		case AREF:
+			visitor.aref(*static_cast<ARef*>(e));
+			break;
+		default:
+			break;
+		}
+	}
+
+	/*!
+	 * \brief Bounding box of one element, with the structures it references.
+	 *
+	 * It is the box the element adds to Structure::bbox(), in the
+	 * coordinates of its structure.
+	 */
+	Box elementBox(Element *e);
+	/*!
+	 * \brief The hash one element adds to Structure::hash().
+	 */
+	unsigned long long elementHash(Element *e);
+
+	/*!
+	 * \brief Exact comparison of structures and elements.
+	 *
+	 * It confirms what equal hashes suggest. Elements are compared field
+	 * by field on what Structure::hash() covers, and references must place
+	 * structures which are equal in turn, or have the same name if both are
+	 * unresolved. The elements of two structures are matched in any order.
+	 * Every pair of structures is compared once per comparer; a pair met
+	 * again while it is being compared counts as equal.
+	 */
+	class StructureComparer
+	{
+		std::map<std::pair<Structure*, Structure*>, bool> Known;
+
+		bool equalTargets(Structure *a, StringId a_name, Structure *b, StringId b_name);
+
+	public:
+		bool equal(Structure *a, Structure *b);
+		bool equal(Element *a, Element *b);
+	};
+
+	template<class Visitor>
+	void Structure::visit(Visitor &visitor, size_t first, size_t last)
+	{
+		load();
+		if (last > Contents.size())
+			last = Contents.size();
+		for (size_t i = first; i < last; i++)
+		{
+			if (Contents[i] != nullptr)
+				visitElement(visitor, Contents[i]);
+		}
+	}
+
 }
 
 
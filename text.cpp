@@ -24,6 +24,7 @@
 #include "log.h"
 #include <sstream>
 #include "gdsio.h"
+#include "stringtable.h"
 
 namespace GDS
 {
@@ -35,7 +36,7 @@ namespace GDS
 		Text_type = -1;
 		Presentation = 0;
 		Strans = 0;
-		String = "";
+		String = 0;
 	}
 
 	Text::~Text()
@@ -69,7 +70,17 @@ namespace GDS
 		y = Y;
 	}
 
+	Box Text::bbox() const
+	{
+		return Box(X, Y, X, Y);
+	}
+
 	std::string Text::string() const
+	{
+		return internedString(String);
+	}
+
+	StringId Text::stringId() const
 	{
 		return String;
 	}
@@ -77,45 +88,54 @@ namespace GDS
 	void Text::setLayer(short layer)
 	{
 		Layer = layer;
+		touch();
 	}
 
 	void Text::setTextType(short text_type)
 	{
 		Text_type = text_type;
+		touch();
 	}
 
 	void Text::setPresentation(short presentation)
 	{
 		Presentation = presentation;
+		touch();
 	}
 
 	void Text::setStrans(short strans)
 	{
 		Strans = strans;
+		touch();
 	}
 
 	void Text::setXY(int x, int y)
 	{
 		X = x;
 		Y = y;
+		touch();
 	}
 
 	void Text::setString(std::string string)
 	{
-		String = string;
+		String = internString(string);
+		touch();
 	}
 
-	bool Text::read(std::ifstream &in)
+	bool Text::read(RecordReader &reader)
 	{
 #ifdef _DEBUG_LOG
         LogIO* log = LogIO::getInstance();
 #endif
+		const Record &rec = reader.record();
 		bool finished = false;
 		while (!finished)
 		{
-			short record_size = readShort(in);
-			Byte record_type = readByte(in);
-			Byte data_type = readByte(in);
+			if (!reader.next())
+				throw FormatError("unexpected end of file in TEXT.");
+			int record_size = rec.size;
+			Byte record_type = rec.record_type;
+			Byte data_type = rec.data_type;
 			switch (record_type)
 			{
 			case ENDEL:
@@ -138,7 +158,7 @@ namespace GDS
 					std::string msg = ss.str();
 					throw FormatError(msg);
 				}
-				Eflags = readShort(in);
+				Eflags = rec.getShort();
 #ifdef _DEBUG_LOG
                 {
                     std::stringstream ss;
@@ -157,7 +177,7 @@ namespace GDS
 					std::string msg = ss.str();
 					throw FormatError(msg);
 				}
-				Layer = readShort(in);
+				Layer = rec.getShort();
 #ifdef _DEBUG_LOG
                 {
                     std::stringstream ss;
@@ -176,7 +196,7 @@ namespace GDS
 					std::string msg = ss.str();
 					throw FormatError(msg);
 				}
-				Text_type = readShort(in);
+				Text_type = rec.getShort();
 #ifdef _DEBUG_LOG
                 {
                     std::stringstream ss;
@@ -196,8 +216,8 @@ namespace GDS
 					std::string msg = ss.str();
 					throw FormatError(msg);
 				}
-				X = readInteger(in);
-				Y = readInteger(in);
+				X = rec.getInteger(0);
+				Y = rec.getInteger(1);
 #ifdef _DEBUG_LOG
                 {
                     std::stringstream ss;
@@ -217,7 +237,7 @@ namespace GDS
 					std::string msg = ss.str();
 					throw FormatError(msg);
 				}
-				Presentation = readShort(in);
+				Presentation = rec.getShort();
 #ifdef _DEBUG_LOG
                 {
                     std::stringstream ss;
@@ -236,7 +256,7 @@ namespace GDS
 					std::string msg = ss.str();
 					throw FormatError(msg);
 				}
-				Strans = readShort(in);
+				Strans = rec.getShort();
 #ifdef _DEBUG_LOG
                 {
                     std::stringstream ss;
@@ -255,11 +275,11 @@ namespace GDS
 					std::string msg = ss.str();
 					throw FormatError(msg);
 				}
-				String = readString(in, record_size - 4);
+				String = internString(rec.getString());
 #ifdef _DEBUG_LOG
                 {
                     std::stringstream ss;
-                    ss << std::dec << " " << record_size << " " << Record_name[record_type] << " " << data_type << " " << String << std::endl;
+                    ss << std::dec << " " << record_size << " " << Record_name[record_type] << " " << data_type << " " << internedString(String) << std::endl;
                     log->write(ss.str());
                 }
 #endif
@@ -271,64 +291,17 @@ namespace GDS
 		return true;
 	}
 
-	bool Text::write(std::ofstream &out)
+	bool Text::write(RecordWriter &writer)
 	{
-		short record_size;
-
-		record_size = 4;
-		writeShort(out, record_size);
-		writeByte(out, TEXT);
-		writeByte(out, NoData);
-
-		record_size = 6;
-		writeShort(out, record_size);
-		writeByte(out, EFLAGS);
-		writeByte(out, Integer_2);
-		writeShort(out, Eflags);
-
-		record_size = 6;
-		writeShort(out, record_size);
-		writeByte(out, LAYER);
-		writeByte(out, Integer_2);
-		writeShort(out, Layer);
-
-		record_size = 6;
-		writeShort(out, record_size);
-		writeByte(out, TEXTTYPE);
-		writeByte(out, Integer_2);
-		writeShort(out, Text_type);
-
-		record_size = 6;
-		writeShort(out, record_size);
-		writeByte(out, PRESENTATION);
-		writeByte(out, Integer_2);
-		writeShort(out, Presentation);
-
-		record_size = 6;
-		writeShort(out, record_size);
-		writeByte(out, STRANS);
-		writeByte(out, Integer_2);
-		writeShort(out, Strans);
-
-		record_size = 12;
-		writeShort(out, record_size);
-		writeByte(out, XY);
-		writeByte(out, Integer_4);
-		writeInteger(out, X);
-		writeInteger(out, Y);
-
-		record_size = 4 + String.size();
-		if (record_size % 2 != 0)
-			record_size += 1;
-		writeShort(out, record_size);
-		writeByte(out, STRING);
-		writeByte(out, GDS::String);
-		writeString(out, String);
-
-		record_size = 4;
-		writeShort(out, record_size);
-		writeByte(out, ENDEL);
-		writeByte(out, NoData);
+		writer.writeRecord(TEXT);
+		writer.writeShort(EFLAGS, Eflags);
+		writer.writeShort(LAYER, Layer);
+		writer.writeShort(TEXTTYPE, Text_type);
+		writer.writeShort(PRESENTATION, Presentation);
+		writer.writeShort(STRANS, Strans);
+		writer.writeXY(&X, &Y, 1);
+		writer.writeString(STRING, internedString(String));
+		writer.writeRecord(ENDEL);
 
 		return true;
 	}
@@ -342,7 +315,7 @@ namespace GDS
 		out << "PRESENTATION " << Presentation << std::endl;
 		out << "STRANS " << Strans << std::endl;
 		out << "XY " << X << " " << Y << std::endl;
-		out << "STRING " << String << std::endl;
+		out << "STRING " << internedString(String) << std::endl;
 		out << "ENDEL";
 		return true;
 	}
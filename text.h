@@ -22,6 +22,8 @@
 #ifndef TEXT_H
 #define TEXT_H
 #include "elements.h"
+#include "stringtable.h"
+#include "geometry.h"
 
 namespace GDS {
 
@@ -47,7 +49,7 @@ namespace GDS {
 		short               Presentation;
 		short               Strans;
 		int                 X, Y;
-		std::string         String;
+		StringId            String;
 
 	public:
 		Text(Structure* parent);
@@ -58,7 +60,12 @@ namespace GDS {
 		short presentation() const;
 		short strans() const;
 		void xy(int &x, int &y) const;
+		/*!
+		 * The box of the origin; the extent of the string is unknown.
+		 */
+		Box bbox() const;
 		std::string string() const;
+		StringId stringId() const;
 
 		void setLayer(short layer);
 		void setTextType(short text_type);
@@ -67,8 +74,8 @@ namespace GDS {
 		void setXY(int x, int y);
 		void setString(std::string string);
 
-		virtual bool read(std::ifstream &in);
-		virtual bool write(std::ofstream &out);
+		virtual bool read(RecordReader &reader);
+		virtual bool write(RecordWriter &writer);
 		virtual bool printASCII(std::ofstream &out);
 	};
 